@@ -0,0 +1,71 @@
+#pragma once
+
+// Synthetic music libraries and timing helpers shared by the benchmarks.
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+inline const char* const words[] = {
+    "Daft", "Punk", "Something", "About", "Us", "The", "Beatles", "Help", "Love", "Song", "Remix", "Live",
+    "Night", "Blue", "Dream", "Radio", "Edit", "Original", "Mix", "Feat", "Summer", "City", "Lights", "Heart"
+};
+
+// Paths shaped like a real library: artist and album directories, a few words per title.
+// The same count always produces the same paths.
+inline std::vector<std::string> makeLibrary(size_t count) {
+    std::mt19937 rng(42);
+    std::vector<std::string> paths;
+    paths.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string path = "../Songs/Artist " + std::to_string(i % 997) + "/Album " + std::to_string(i % 31) + "/";
+        int wordCount = 3 + static_cast<int>(rng() % 4);
+        for (int w = 0; w < wordCount; ++w) {
+            path += words[rng() % (sizeof(words) / sizeof(words[0]))];
+            path += w == 1 ? " - " : " ";
+        }
+        path += std::to_string(i) + ".mp3";
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+inline double elapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Function>
+double averageMilliseconds(int repetitions, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        function();
+    }
+    return elapsedMicroseconds(start) / 1000.0 / repetitions;
+}
+
+// Summary of a set of latency samples
+struct Percentiles {
+    double mean = 0, p50 = 0, p95 = 0, max = 0;
+};
+
+inline Percentiles summarize(std::vector<double> samples) {
+    Percentiles result;
+    if (samples.empty()) {
+        return result;
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    result.mean = sum / samples.size();
+    result.p50 = samples[samples.size() / 2];
+    result.p95 = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+    result.max = samples.back();
+    return result;
+}
+
+} // namespace bench
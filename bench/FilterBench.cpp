@@ -0,0 +1,66 @@
+// Compares filterMusicFiles against the SIMD substring kernels on synthetic libraries.
+// Built as filter-bench by CMake (or `make bench` in src/); no audio or window is needed.
+#include "../header/SubstringMatch.hpp"
+#include "../header/Utilities.hpp"
+#include "BenchLibrary.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using bench::averageMilliseconds;
+using bench::makeLibrary;
+
+int main() {
+    const std::vector<std::string> queries = { "d", "da", "daft p", "LOVE", "remix 12", "zzz" };
+    const MatchKernel kernels[] = { MatchKernel::Scalar, MatchKernel::SSE2, MatchKernel::AVX2 };
+    const char* kernelNames[] = { "scalar", "sse2", "avx2" };
+
+    for (size_t count : { size_t(100000), size_t(1000000) }) {
+        std::vector<std::string> paths = makeLibrary(count);
+
+        // Same layout SearchIndex keeps: lowercased base names, '\0' separated
+        std::string names;
+        std::vector<std::uint32_t> offsets;
+        for (const auto& path : paths) {
+            offsets.push_back(static_cast<std::uint32_t>(names.size()));
+            for (char c : getBaseName(path)) {
+                names += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+            }
+            names += '\0';
+        }
+        offsets.push_back(static_cast<std::uint32_t>(names.size()));
+
+        const int repetitions = count >= 1000000 ? 3 : 10;
+        std::printf("%zu names (%zu bytes)\n", count, names.size());
+        std::printf("  %-10s %14s", "query", "filterMusic");
+        for (const char* name : kernelNames) {
+            std::printf(" %10s", name);
+        }
+        std::printf("   (ms per query)\n");
+
+        for (const auto& query : queries) {
+            std::vector<std::string> filtered;
+            double baseline = averageMilliseconds(repetitions, [&]() { filterMusicFiles(paths, query, filtered); });
+            std::printf("  %-10s %14.2f", ("\"" + query + "\"").c_str(), baseline);
+
+            for (MatchKernel kernel : kernels) {
+                if (!isMatchKernelSupported(kernel)) {
+                    std::printf(" %10s", "n/a");
+                    continue;
+                }
+                std::vector<std::uint32_t> matches;
+                double time = averageMilliseconds(repetitions, [&]() {
+                    matches.clear();
+                    findMatchingNames(kernel, names.data(), offsets.data(), count, query, matches);
+                });
+                if (matches.size() != filtered.size()) {
+                    std::printf("\nMismatch for \"%s\": %zu vs %zu\n", query.c_str(), matches.size(), filtered.size());
+                    return 1;
+                }
+                std::printf(" %10.2f", time);
+            }
+            std::printf("   %zu hits\n", filtered.size());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,553 @@
+// Headless benchmarks for the player's hot paths on synthetic libraries of 1k to 1M
+// tracks: search-as-you-type (substring and fuzzy, inline and on the search worker), path storage, memory per track, shuffle navigation, song list layout per frame,
+// library scanning and playlist import/export, plus loudness analysis and the DSP chain on one synthetic track. Results are
+// written as JSON for regression tracking.
+//
+//   player-bench [--max-entries=N] [--max-scan-entries=N] [--output=path]
+//
+// Scanning creates empty files under the system temp directory, so it has its own,
+// lower limit.
+#include "../header/DspStages.hpp"
+#include "../header/LibraryScanner.hpp"
+#include "../header/ListLayout.hpp"
+#include "../header/LoudnessMeter.hpp"
+#include "../header/Playlist.hpp"
+#include "../header/SearchIndex.hpp"
+#include "../header/SearchWorker.hpp"
+#include "../header/ShuffleOrder.hpp"
+#include "../header/TrackStore.hpp"
+#include "../header/Utilities.hpp"
+#include "BenchLibrary.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Result {
+    std::string name;
+    size_t entries;
+    std::map<std::string, double> metrics;
+};
+
+void addPercentiles(Result& result, const std::string& prefix, const bench::Percentiles& percentiles) {
+    result.metrics[prefix + "mean_us"] = percentiles.mean;
+    result.metrics[prefix + "p50_us"] = percentiles.p50;
+    result.metrics[prefix + "p95_us"] = percentiles.p95;
+    result.metrics[prefix + "max_us"] = percentiles.max;
+}
+
+// Types each query one character at a time, then clears the box, like a user would
+Result benchFilter(const std::vector<std::string>& paths) {
+    const std::vector<std::string> queries = { "daft punk", "love remix", "summer city lights", "zzz", "artist 12" };
+    Result result{ "filter", paths.size(), {} };
+    TrackStore tracks(paths);
+
+    auto start = std::chrono::steady_clock::now();
+    SearchIndex index(tracks);
+    result.metrics["build_ms"] = bench::elapsedMicroseconds(start) / 1000.0;
+
+    std::vector<double> keystrokes;
+    size_t hits = 0;
+    for (const auto& query : queries) {
+        for (size_t length = 1; length <= query.size(); ++length) {
+            std::string prefix = query.substr(0, length);
+            auto keystroke = std::chrono::steady_clock::now();
+            hits += index.search(prefix).size();
+            keystrokes.push_back(bench::elapsedMicroseconds(keystroke));
+        }
+        auto clear = std::chrono::steady_clock::now();
+        index.search("");
+        keystrokes.push_back(bench::elapsedMicroseconds(clear));
+    }
+    addPercentiles(result, "keystroke_", bench::summarize(keystrokes));
+    result.metrics["keystrokes"] = static_cast<double>(keystrokes.size());
+    result.metrics["hits"] = static_cast<double>(hits);
+    return result;
+}
+
+// Fuzzy queries typed a character at a time, keeping the best 100 as the GUI does,
+// on every core and on one
+Result benchFuzzy(const std::vector<std::string>& paths) {
+    const std::vector<std::string> queries = { "dpsau", "lvrmx", "summer lights", "city 12", "zzz" };
+    Result result{ "fuzzy", paths.size(), {} };
+    TrackStore tracks(paths);
+    SearchIndex index(tracks);
+
+    std::vector<FuzzyMatch> matches;
+    size_t hits = 0;
+    for (unsigned int threads : { 0u, 1u }) {
+        std::vector<double> keystrokes;
+        for (const auto& query : queries) {
+            for (size_t length = 1; length <= query.size(); ++length) {
+                auto keystroke = std::chrono::steady_clock::now();
+                index.searchFuzzy(query.substr(0, length), 100, matches, threads);
+                keystrokes.push_back(bench::elapsedMicroseconds(keystroke));
+                hits += matches.size();
+            }
+        }
+        addPercentiles(result, threads == 0 ? "keystroke_" : "single_thread_keystroke_", bench::summarize(keystrokes));
+    }
+    result.metrics["hits"] = static_cast<double>(hits);
+    return result;
+}
+
+// Types on the search worker at a fast typist's pace and times each keystroke to
+// the first results the list could show and to the last. Keystrokes that arrive
+// before a search completes supersede it, as they would in the player.
+Result benchSearchWorker(const std::vector<std::string>& paths) {
+    const std::vector<std::string> queries = { "dpsau", "lvrmx", "summer lights", "city 12", "zzz" };
+    const auto keystrokeInterval = std::chrono::milliseconds(30);
+    Result result{ "search_worker", paths.size(), {} };
+    TrackStore tracks(paths);
+    SearchWorker worker(tracks, 100);
+
+    std::vector<std::uint32_t> results;
+    for (bool fuzzy : { true, false }) {
+        std::vector<double> firstResults, completions;
+        size_t superseded = 0;
+        for (const auto& query : queries) {
+            for (size_t length = 1; length <= query.size(); ++length) {
+                auto keystroke = std::chrono::steady_clock::now();
+                worker.submit(query.substr(0, length), fuzzy);
+                bool first = true;
+                bool complete = false;
+                // A frame loop would poll once per frame; poll faster so the timings are the worker's
+                while (!complete && std::chrono::steady_clock::now() - keystroke < keystrokeInterval) {
+                    if (worker.takeResults(results, complete) && first) {
+                        firstResults.push_back(bench::elapsedMicroseconds(keystroke));
+                        first = false;
+                    }
+                    if (complete) {
+                        completions.push_back(bench::elapsedMicroseconds(keystroke));
+                    }
+                    else {
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    }
+                }
+                superseded += complete ? 0 : 1;
+                std::this_thread::sleep_until(keystroke + keystrokeInterval);
+            }
+        }
+        std::string mode = fuzzy ? "fuzzy_" : "substring_";
+        if (!firstResults.empty()) {
+            addPercentiles(result, mode + "first_result_", bench::summarize(firstResults));
+        }
+        if (!completions.empty()) {
+            addPercentiles(result, mode + "complete_", bench::summarize(completions));
+        }
+        result.metrics[mode + "superseded"] = static_cast<double>(superseded);
+    }
+    return result;
+}
+
+// Memory and a pass over every base name, for the path strings the player used to
+// keep against the interned store
+Result benchTrackStore(const std::vector<std::string>& paths) {
+    Result result{ "track_store", paths.size(), {} };
+
+    size_t stringBytes = paths.capacity() * sizeof(std::string);
+    for (const auto& path : paths) {
+        // Longer strings than the small-string buffer own a heap block
+        if (path.capacity() > std::string().capacity()) {
+            stringBytes += path.capacity() + 1;
+        }
+    }
+    result.metrics["strings_bytes_per_track"] = static_cast<double>(stringBytes) / paths.size();
+
+    auto start = std::chrono::steady_clock::now();
+    TrackStore tracks(paths);
+    tracks.shrinkToFit();
+    result.metrics["build_ms"] = bench::elapsedMicroseconds(start) / 1000.0;
+    result.metrics["store_bytes_per_track"] = static_cast<double>(tracks.getMemoryUsage()) / tracks.size();
+    result.metrics["directories"] = static_cast<double>(tracks.getDirectoryCount());
+
+    size_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (const auto& path : paths) {
+        checksum += getBaseName(path).size();
+    }
+    result.metrics["strings_names_ms"] = bench::elapsedMicroseconds(start) / 1000.0;
+    start = std::chrono::steady_clock::now();
+    for (size_t id = 0; id < tracks.size(); ++id) {
+        checksum += tracks.getBaseName(id).size();
+    }
+    result.metrics["store_names_ms"] = bench::elapsedMicroseconds(start) / 1000.0;
+
+    bool same = true;
+    for (size_t id = 0; id < tracks.size() && same; ++id) {
+        same = tracks.getPath(id) == paths[id];
+    }
+    if (!same) {
+        std::cerr << "TrackStore does not give back the paths it was built from" << std::endl;
+    }
+    result.metrics["checksum"] = static_cast<double>(checksum);
+    return result;
+}
+
+// What the whole process holds per track once startup is done, measured as its
+// resident growth: the scanner's entries are turned into the path store and file
+// stamps and freed, then the player's store, search index and shuffle order are
+// built on top. The SFML side (caches, GUI) is not part of this build.
+Result benchLibraryMemory(const std::vector<std::string>& paths) {
+    Result result{ "library_memory", paths.size(), {} };
+    size_t before = getResidentMemory();
+    if (before == 0) {
+        return result;
+    }
+
+    std::vector<LibraryEntry> entries(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        entries[i].path = paths[i];
+        entries[i].size = i;
+        entries[i].mtime = static_cast<std::int64_t>(i);
+    }
+    TrackStore library;
+    FileStamps stamps;
+    library.reserve(entries.size());
+    stamps.sizes.reserve(entries.size());
+    stamps.mtimes.reserve(entries.size());
+    for (const auto& entry : entries) {
+        library.add(entry.path);
+        stamps.sizes.push_back(entry.size);
+        stamps.mtimes.push_back(entry.mtime);
+    }
+    library.shrinkToFit();
+    std::vector<LibraryEntry>().swap(entries);
+
+    TrackStore tracks(&library);
+    SearchIndex index(tracks);
+    ShuffleOrder order(tracks.size(), 1234);
+    size_t after = getResidentMemory();
+    result.metrics["process_bytes_per_track"] = (static_cast<double>(after) - static_cast<double>(before)) / paths.size();
+    result.metrics["resident_bytes_per_track"] = static_cast<double>(after) / paths.size();
+    result.metrics["checksum"] = static_cast<double>(index.size() + order.size() + stamps.sizes.size());
+    return result;
+}
+
+Result benchShuffle(size_t count) {
+    Result result{ "shuffle", count, {} };
+    ShuffleOrder order(count, 1234);
+    const size_t steps = 200000;
+
+    auto start = std::chrono::steady_clock::now();
+    order.reshuffle();
+    result.metrics["reshuffle_us"] = bench::elapsedMicroseconds(start);
+
+    size_t track = 0;
+    order.playNow(track);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < steps; ++i) {
+        track = order.next(track);
+    }
+    result.metrics["next_ns"] = bench::elapsedMicroseconds(start) * 1000.0 / steps;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < steps; ++i) {
+        track = order.previous(track);
+    }
+    result.metrics["previous_ns"] = bench::elapsedMicroseconds(start) * 1000.0 / steps;
+
+    std::mt19937 rng(99);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < steps; ++i) {
+        track = rng() % count;
+        order.playNow(track);
+        track = order.next(track);
+    }
+    result.metrics["play_now_next_ns"] = bench::elapsedMicroseconds(start) * 1000.0 / steps;
+
+    // Keeps the loops from being optimized away
+    result.metrics["checksum"] = static_cast<double>(track);
+    return result;
+}
+
+// One simulated frame: advance the scroll animation, lay out the visible rows and hit-test the pointer
+Result benchLayout(size_t count) {
+    Result result{ "layout", count, {} };
+    ListLayout layout(60.0f, 50.0f);
+    layout.setViewport(60.0f, 900.0f);
+    layout.setRowCount(count);
+
+    const int frames = 20000;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frames);
+    double checksum = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        if (frame % 30 == 0) {
+            // Alternate between wheel scrolling, paging and long jumps
+            switch ((frame / 30) % 4) {
+            case 0: layout.scrollBy(240.0f); break;
+            case 1: layout.page(1); break;
+            case 2: layout.scrollBy(-120.0f); break;
+            case 3: layout.ensureVisible((static_cast<size_t>(frame) * 7919) % count); break;
+            }
+        }
+        layout.update(1.0f / 60.0f);
+        for (size_t row = layout.getFirstVisibleRow(); row < layout.getEndVisibleRow(); ++row) {
+            checksum += layout.getRowTop(row);
+        }
+        size_t hovered;
+        if (layout.getRowAt(500.0f, hovered)) {
+            checksum += static_cast<double>(hovered);
+        }
+        frameTimes.push_back(bench::elapsedMicroseconds(start));
+    }
+    addPercentiles(result, "frame_", bench::summarize(frameTimes));
+    result.metrics["checksum"] = checksum;
+    return result;
+}
+
+// Lays the synthetic library out on disk as empty files, then scans it cold and warm
+Result benchScan(const std::vector<std::string>& paths, const fs::path& root) {
+    Result result{ "scan", paths.size(), {} };
+    std::error_code error;
+    fs::remove_all(root, error);
+    fs::path songs = root / "Songs";
+    for (const auto& path : paths) {
+        // makeLibrary paths start with "../Songs/"
+        fs::path file = songs / path.substr(9);
+        fs::create_directories(file.parent_path(), error);
+        std::ofstream(file.string());
+    }
+    std::string indexPath = (root / "library.idx").string();
+
+    auto start = std::chrono::steady_clock::now();
+    size_t found = LibraryScanner(songs.string(), indexPath).scan().size();
+    double cold = bench::elapsedMicroseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    LibraryScanner warmScanner(songs.string(), indexPath);
+    warmScanner.scan();
+    double warm = bench::elapsedMicroseconds(start);
+
+    result.metrics["files_found"] = static_cast<double>(found);
+    result.metrics["cold_ms"] = cold / 1000.0;
+    result.metrics["cold_files_per_s"] = found / (cold / 1e6);
+    result.metrics["warm_ms"] = warm / 1000.0;
+    result.metrics["warm_files_per_s"] = found / (warm / 1e6);
+    result.metrics["warm_directories_reused"] = static_cast<double>(warmScanner.getDirectoriesReused());
+
+    fs::remove_all(root, error);
+    return result;
+}
+
+void writeJson(std::FILE* out, const std::vector<Result>& results) {
+    std::fprintf(out, "{\n  \"benchmark\": \"player-bench\",\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        std::fprintf(out, "    {\"name\": \"%s\", \"entries\": %zu", result.name.c_str(), result.entries);
+        for (const auto& metric : result.metrics) {
+            std::fprintf(out, ", \"%s\": %.6g", metric.first.c_str(), metric.second);
+        }
+        std::fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+bool readCount(const std::string& argument, const char* prefix, size_t& value) {
+    std::string name = prefix;
+    if (argument.compare(0, name.size(), name) != 0) {
+        return false;
+    }
+    value = static_cast<size_t>(std::strtoull(argument.c_str() + name.size(), nullptr, 10));
+    return true;
+}
+
+} // namespace
+
+// Exports the library as M3U and PLS next to it, then loads both back
+Result benchPlaylist(const std::vector<std::string>& paths, const fs::path& root) {
+    Result result{ "playlist", paths.size(), {} };
+    std::error_code ec;
+    fs::create_directories(root, ec);
+    for (const char* extension : { ".m3u8", ".pls" }) {
+        std::string playlist = (root / ("library" + std::string(extension))).string();
+        std::string name = extension + 1;
+
+        auto start = std::chrono::steady_clock::now();
+        Playlist::save(playlist, paths);
+        result.metrics[name + "_save_ms"] = bench::elapsedMicroseconds(start) / 1000.0;
+        result.metrics[name + "_bytes"] = static_cast<double>(fs::file_size(playlist, ec));
+
+        std::vector<std::string> loaded;
+        start = std::chrono::steady_clock::now();
+        Playlist::load(playlist, loaded);
+        result.metrics[name + "_load_ms"] = bench::elapsedMicroseconds(start) / 1000.0;
+        if (loaded.size() != paths.size()) {
+            std::cerr << "Playlist round trip lost entries: " << loaded.size() << " of " << paths.size() << std::endl;
+        }
+    }
+    fs::remove_all(root, ec);
+    return result;
+}
+
+// Five minutes of stereo 44.1 kHz noise shaped like music, measured as the library analysis does
+Result benchLoudness() {
+    Result result{ "loudness", 1, {} };
+    const unsigned int sampleRate = 44100;
+    const size_t frames = sampleRate * 300;
+    std::vector<std::int16_t> samples(frames * 2);
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0.0f, 3000.0f);
+    for (size_t i = 0; i < frames; ++i) {
+        float envelope = 0.5f + 0.5f * std::sin(i * 6.2831853f / sampleRate);
+        samples[i * 2] = static_cast<std::int16_t>(std::max(-32768.0f, std::min(32767.0f, noise(rng) * envelope)));
+        samples[i * 2 + 1] = static_cast<std::int16_t>(std::max(-32768.0f, std::min(32767.0f, noise(rng) * envelope)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    LoudnessMeter meter(sampleRate, 2);
+    const size_t block = 1 << 15;   // Frames per call, like a decoder block
+    for (size_t offset = 0; offset < frames; offset += block) {
+        meter.addFrames(samples.data() + offset * 2, std::min(block, frames - offset));
+    }
+    double loudness = meter.getIntegratedLoudness();
+    double elapsed = bench::elapsedMicroseconds(start);
+
+    result.metrics["audio_s"] = 300.0;
+    result.metrics["measure_ms"] = elapsed / 1000.0;
+    result.metrics["realtime_factor"] = 300.0 / (elapsed / 1e6);
+    result.metrics["loudness_lufs"] = loudness;
+    result.metrics["true_peak_dbtp"] = LoudnessMeter::toDecibels(meter.getTruePeak());
+    return result;
+}
+
+// Ten seconds of stereo noise through each stage alone and the whole chain, in the
+// buffer size PlaybackStream uses, against the real-time budget of one buffer
+Result benchDsp() {
+    Result result{ "dsp", 1, {} };
+    const unsigned int sampleRate = 44100;
+    const size_t frames = sampleRate * 10;
+    const size_t bufferSamples = sampleRate / 10 * 2;   // 100 ms of stereo
+    std::vector<std::int16_t> samples(frames * 2);
+    std::mt19937 rng(11);
+    std::normal_distribution<float> noise(0.0f, 6000.0f);
+    for (auto& sample : samples) {
+        sample = static_cast<std::int16_t>(std::max(-32768.0f, std::min(32767.0f, noise(rng))));
+    }
+
+    auto measure = [&](const std::string& name, DspChain& chain) {
+        std::vector<std::int16_t> work = samples;
+        chain.prepare(sampleRate, 2, bufferSamples);
+        std::vector<double> buffers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < work.size(); offset += bufferSamples) {
+            auto buffer = std::chrono::steady_clock::now();
+            chain.process(work.data() + offset, std::min(bufferSamples, work.size() - offset));
+            buffers.push_back(bench::elapsedMicroseconds(buffer));
+        }
+        double elapsed = bench::elapsedMicroseconds(start);
+        result.metrics[name + "_msamples_per_s"] = work.size() / elapsed;
+        bench::Percentiles percentiles = bench::summarize(buffers);
+        addPercentiles(result, name + "_buffer_", percentiles);
+        result.metrics[name + "_budget_percent"] = percentiles.max / 1000.0;  // Worst buffer, of its 100 ms
+    };
+
+    // Conversion alone: a stage that is never neutral but does nothing
+    struct Passthrough : DspStage {
+        void prepare(unsigned int, unsigned int) override {}
+        void process(float*, size_t) override {}
+    };
+    DspChain conversion;
+    conversion.add(std::make_unique<Passthrough>());
+    measure("convert", conversion);
+
+    DspChain preamp;
+    preamp.add(std::make_unique<Preamp>(-3.0f));
+    measure("preamp", preamp);
+
+    DspChain equalizer;
+    auto eq = std::make_unique<ParametricEq>();
+    for (size_t band = 0; band < eq->getBandCount(); ++band) {
+        ParametricEq::Band settings = eq->getBand(band);
+        settings.gain = band % 2 ? -4.0f : 3.0f;
+        eq->setBand(band, settings);
+    }
+    equalizer.add(std::move(eq));
+    measure("eq10", equalizer);
+
+    DspChain limiter;
+    limiter.add(std::make_unique<Passthrough>());
+    limiter.add(std::make_unique<SoftLimiter>());
+    measure("limiter", limiter);
+
+    DspChain chain;
+    chain.add(std::make_unique<Preamp>(6.0f));
+    auto fullEq = std::make_unique<ParametricEq>();
+    for (size_t band = 0; band < fullEq->getBandCount(); ++band) {
+        ParametricEq::Band settings = fullEq->getBand(band);
+        settings.gain = band % 2 ? -4.0f : 3.0f;
+        fullEq->setBand(band, settings);
+    }
+    chain.add(std::move(fullEq));
+    chain.add(std::make_unique<SoftLimiter>());
+    measure("chain", chain);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxEntries = 1000000;
+    size_t maxScanEntries = 100000;
+    std::string outputPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (readCount(argument, "--max-entries=", maxEntries) || readCount(argument, "--max-scan-entries=", maxScanEntries)) {
+            continue;
+        }
+        if (argument.compare(0, 9, "--output=") == 0) {
+            outputPath = argument.substr(9);
+            continue;
+        }
+        std::cerr << "Unknown argument: " << argument << std::endl;
+        return 2;
+    }
+
+    fs::path scanRoot = fs::temp_directory_path() / ("player-bench-" + std::to_string(std::random_device{}()));
+    std::vector<Result> results;
+    for (size_t count = 1000; count <= maxEntries; count *= 10) {
+        std::cerr << "Benchmarking " << count << " entries" << std::endl;
+        std::vector<std::string> paths = bench::makeLibrary(count);
+        results.push_back(benchFilter(paths));
+        results.push_back(benchFuzzy(paths));
+        results.push_back(benchSearchWorker(paths));
+        results.push_back(benchTrackStore(paths));
+        results.push_back(benchLibraryMemory(paths));
+        results.push_back(benchShuffle(count));
+        results.push_back(benchLayout(count));
+        if (count <= maxScanEntries) {
+            results.push_back(benchScan(paths, scanRoot));
+        }
+        results.push_back(benchPlaylist(paths, scanRoot));
+    }
+
+    std::cerr << "Benchmarking loudness analysis" << std::endl;
+    results.push_back(benchLoudness());
+    std::cerr << "Benchmarking the DSP chain" << std::endl;
+    results.push_back(benchDsp());
+
+    std::FILE* out = stdout;
+    if (!outputPath.empty()) {
+        out = std::fopen(outputPath.c_str(), "w");
+        if (!out) {
+            std::cerr << "Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    writeJson(out, results);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MusicPlayer.hpp"
+#include "SearchIndex.hpp"
+
+// Drives a MusicPlayer without a window, taking commands over a Unix domain socket.
+// The protocol is one request per line and one response per request:
+//
+//   play [id]      resume, or start track id      -> OK
+//   pause                                         -> OK
+//   next | prev                                   -> OK <id>
+//   seek <seconds>                                -> OK
+//   search <text>  substring match on file names  -> OK <count>, then up to 50 lines "<id> <name>"
+//   fuzzy <text>   ranked fuzzy match on names    -> OK <count>, then the best (up to 50) "<id> <name>", best first
+//   status                                        -> OK <playing|paused|stopped|loading> <id> <position> <duration> <name>
+//   quit           stop the daemon                -> OK
+//
+// Anything else gets "ERR <reason>". Clients may pipeline requests; any number
+// of clients can be connected. The loop also keeps playback moving from song to song.
+class ControlServer {
+public:
+    ControlServer(MusicPlayer& player, const std::string& socketPath);
+    ~ControlServer();
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Serves until quit is requested or stop() is called. Returns false if the socket could not be opened.
+    bool run();
+    // Safe to call from a signal handler
+    void stop() { stopping = true; }
+    // Applies the tracks the watcher finds added to or removed from the library as they come
+    void watchLibrary(LibraryWatcher* watcher) { libraryWatcher = watcher; }
+
+private:
+    struct Client {
+        int socket;             // -1 once closed, until it is dropped from clients
+        std::string input;
+        std::string output;
+        bool finished = false;  // Sent everything it is going to; close once answered
+    };
+
+    bool listen();
+    void accept();
+    bool readFrom(Client& client);
+    bool writeTo(Client& client);
+    void handle(const std::string& request, std::string& response);
+    void advancePlayback();
+    void applyLibraryChanges();
+    SearchIndex& getSearchIndex();
+
+    MusicPlayer& player;
+    std::unique_ptr<SearchIndex> searchIndex;   // Built on the first search, to keep startup fast
+    LibraryWatcher* libraryWatcher = nullptr;
+    LibraryChanges libraryChanges;
+    std::string socketPath;
+    int listener = -1;
+    std::vector<Client> clients;
+    std::atomic<bool> stopping{ false };
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One step of a DspChain, working in place on interleaved float frames in [-1, 1].
+// process() runs on the audio thread, so it must not allocate, lock or wait;
+// anything it needs is sized in prepare(). Setters meant for other threads have
+// to hand their values over without blocking process().
+class DspStage {
+public:
+    virtual ~DspStage() = default;
+
+    // Called outside the audio callback whenever the format changes
+    virtual void prepare(unsigned int sampleRate, unsigned int channelCount) = 0;
+    virtual void process(float* samples, size_t frameCount) = 0;
+    // Forgets filter history, e.g. after a seek
+    virtual void reset() {}
+    // True while process() would leave any full-scale signal as it is; a chain
+    // made only of neutral stages is skipped without converting to float
+    virtual bool isNeutral() const { return false; }
+};
+
+// Runs interleaved 16-bit audio through its stages in float and back
+class DspChain {
+public:
+    // Stages run in the order they were added. Only while nothing is calling process().
+    void add(std::unique_ptr<DspStage> stage);
+
+    // Sizes the float buffer for blocks of up to maxSamples and prepares every stage
+    void prepare(unsigned int sampleRate, unsigned int channelCount, size_t maxSamples);
+    void reset();
+    bool isNeutral() const;
+
+    // In place on count interleaved samples (whole frames). Allocation free.
+    void process(std::int16_t* samples, size_t count);
+
+    static void toFloat(const std::int16_t* samples, float* out, size_t count);
+    static void toInt16(const float* samples, std::int16_t* out, size_t count);
+
+private:
+    std::vector<std::unique_ptr<DspStage>> stages;
+    std::vector<float> buffer;
+    unsigned int channelCount = 0;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "DspChain.hpp"
+
+// Constant gain in front of the rest of the chain
+class Preamp : public DspStage {
+public:
+    explicit Preamp(float decibels = 0.0f);
+
+    // Safe from any thread
+    void setGain(float decibels);
+    float getGain() const { return decibels.load(std::memory_order_relaxed); }
+
+    void prepare(unsigned int sampleRate, unsigned int channelCount) override;
+    void process(float* samples, size_t frameCount) override;
+    bool isNeutral() const override { return gain.load(std::memory_order_relaxed) == 1.0f; }
+
+private:
+    std::atomic<float> decibels;
+    std::atomic<float> gain;
+    unsigned int channelCount = 0;
+};
+
+// Cascade of biquad filters (RBJ cookbook shapes). Channels are filtered in
+// pairs of SIMD lanes; bands set to 0 dB are skipped.
+class ParametricEq : public DspStage {
+public:
+    enum class Shape { LowShelf, Peaking, HighShelf };
+
+    struct Band {
+        Shape shape = Shape::Peaking;
+        float frequency = 1000.0f;  // Hz
+        float gain = 0.0f;          // dB
+        float q = 1.41f;
+    };
+
+    // Starts with bandCount flat bands spread an octave apart from 31 Hz,
+    // shelves at both ends, like a graphic equalizer
+    explicit ParametricEq(size_t bandCount = 10);
+
+    size_t getBandCount() const { return bands.size(); }
+    // Safe from any thread; the audio thread picks the change up on its next block
+    void setBand(size_t index, const Band& band);
+    Band getBand(size_t index) const;
+
+    void prepare(unsigned int sampleRate, unsigned int channelCount) override;
+    void process(float* samples, size_t frameCount) override;
+    void reset() override;
+    bool isNeutral() const override { return flat.load(std::memory_order_relaxed); }
+
+private:
+    struct Coefficients {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void updateCoefficients();
+
+    mutable std::mutex bandsMutex;  // Guards bands; process() only ever tries it
+    std::vector<Band> bands;
+    std::atomic<unsigned int> bandsVersion{ 1 };
+    std::atomic<bool> flat{ true };
+
+    // Audio thread side, sized in the constructor and prepare()
+    std::vector<Band> appliedBands;
+    unsigned int appliedVersion = 0;
+    std::vector<Coefficients> coefficients;     // Of the bands that are not flat
+    size_t activeBands = 0;
+    std::vector<double> state;                  // z1 and z2 per lane, per band
+    unsigned int sampleRate = 44100;
+    unsigned int channelCount = 0;
+    size_t laneCount = 0;                       // channelCount rounded up to whole pairs
+};
+
+// Keeps peaks below a threshold. Gain drops at once when a peak would cross
+// the soft knee below the threshold and recovers over the release time; peaks
+// inside the knee are bent smoothly towards the threshold instead of clipped.
+// It only guards against boosts from earlier stages, so it counts as neutral.
+class SoftLimiter : public DspStage {
+public:
+    explicit SoftLimiter(float thresholdDecibels = -0.3f, float kneeDecibels = 3.0f, float releaseMilliseconds = 80.0f);
+
+    // Safe from any thread
+    void setThreshold(float decibels);
+
+    void prepare(unsigned int sampleRate, unsigned int channelCount) override;
+    void process(float* samples, size_t frameCount) override;
+    void reset() override { gain = 1.0f; }
+    bool isNeutral() const override { return true; }
+
+private:
+    std::atomic<float> threshold;   // Linear
+    float kneeDecibels;
+    float releaseMilliseconds;
+    float releaseCoefficient = 0.0f;
+    float gain = 1.0f;
+    unsigned int channelCount = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-size FFT of real input. Everything that depends only on the size
+// (window, twiddle factors, bit-reversal order) is computed once in the
+// constructor, and transforms reuse the same scratch buffers, so running it
+// every frame does not allocate. Not safe to share between threads.
+class RealFFT {
+public:
+    // size must be a power of two, at least 4
+    explicit RealFFT(size_t size);
+
+    size_t getSize() const { return size; }
+    size_t getBinCount() const { return size / 2 + 1; }
+
+    // Applies a Hann window to size input samples and writes the power
+    // (squared magnitude) of bins 0..size/2 to power. A full-scale sine
+    // peaks at about (size / 4)^2.
+    void powerSpectrum(const float* input, float* power);
+
+private:
+    void butterflies();
+
+    size_t size;
+    size_t half;                        // Complex points: the real input is transformed as size/2 complex values
+    std::vector<float> window;
+    std::vector<std::uint32_t> bitReversed;
+    std::vector<float> twiddleRe, twiddleIm;  // Per stage, contiguous: stage with span s starts at s - 1
+    std::vector<float> unpackRe, unpackIm;    // e^(-2*pi*i*k/size) for splitting the packed result
+    std::vector<float> re, im;
+};
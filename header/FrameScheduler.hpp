@@ -0,0 +1,33 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "GUI.hpp"
+
+// Runs the main loop. Instead of spinning, it sleeps until there is something to do:
+// - the GUI needs a redraw (input changed something, or an animation is running):
+//   frames are drawn no faster than the frame rate cap
+// - the GUI only wants periodic updates (audio is playing): update() is called at
+//   the tick rate and a frame is drawn only if that update changed something
+// - neither: the thread blocks until the window receives an event, or if the GUI
+//   asks for an idle interval, update() is called that often and input checked in between
+// Input is still handled as soon as it arrives in every mode. Nothing is drawn
+// while the window is minimized.
+class FrameScheduler {
+public:
+    FrameScheduler(sf::RenderWindow& window, BaseGUI& gui, unsigned int maxFramesPerSecond);
+
+    void run();
+
+private:
+    void dispatch(const sf::Event& event);
+    bool wantsFrame() const;
+    sf::Time getDeadline() const;
+
+    sf::RenderWindow& window;
+    BaseGUI& gui;
+    sf::Time frameInterval;
+    sf::Clock clock;
+    sf::Time lastFrame;
+    sf::Time lastTick;
+    bool minimized = false;
+};
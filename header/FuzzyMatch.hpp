@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// fzf-style fuzzy matching over many names at once. The query is split at spaces
+// into terms that may come in any order; each term must appear in the name as a
+// subsequence ("dsbt" in "daft punk - something about us"). A match scores points
+// per character, more where it starts a word or continues the previous match,
+// and loses points for the gaps in between.
+// Names are laid out as for findMatchingNames: already lowercased, each followed
+// by '\0', offsets[i] the start of name i and offsets[count] one past the end.
+struct FuzzyMatch {
+    std::uint32_t id;
+    int score;
+    std::uint32_t length;   // Of the name; shorter names win ties
+};
+
+// Which of a-z and (in six buckets) 0-9 text contains. A name can only match if
+// its mask has every bit of the query's.
+std::uint32_t getCharacterMask(std::string_view text);
+
+// Scores one lowercased name against lowercased terms. Returns false if some term does not match.
+bool scoreFuzzy(std::string_view name, const std::vector<std::string>& terms, int& score);
+
+// Fills matches with the best limit matches, best first (ties go to the shorter
+// name, then the lower id). Names with skip[id] set are left out, and masks[id]
+// (getCharacterMask of each name) rules names out before they are scored; either
+// may be null.
+// Large libraries are scored in chunks on threadCount threads (0 picks one per core),
+// each keeping its own bounded heap, so memory stays O(limit) per thread.
+void findFuzzyMatches(const char* names, const std::uint32_t* offsets, const std::uint32_t* masks, size_t count, const char* skip,
+    const std::string& query, size_t limit, std::vector<FuzzyMatch>& matches, unsigned int threadCount = 0);
+
+// Puts matches in rank order and keeps the best limit, as findFuzzyMatches does.
+// Merges the results of searches over parts of a library.
+void rankFuzzyMatches(std::vector<FuzzyMatch>& matches, size_t limit);
@@ -2,6 +2,13 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 #include "MusicPlayer.hpp"
+#include "MetadataCache.hpp"
+#include "SearchWorker.hpp"
+#include "ListLayout.hpp"
+#include "SpectrumAnalyzer.hpp"
+#include "WaveformCache.hpp"
+#include "Profiler.hpp"
+#include <unordered_map>
 
 enum class Page { Home, NowPlaying };
 
@@ -11,22 +18,42 @@ public:
     BaseGUI(sf::RenderWindow& window, MusicPlayer& player) : window(window), player(player) {}
     virtual ~BaseGUI() = default;
 
-    virtual void handleEvents() = 0;
+    virtual void handleEvent(const sf::Event& event) = 0;
     virtual void update() = 0;
     virtual void draw() = 0;
 
+    // Hints for FrameScheduler. A GUI that animates wants every frame drawn;
+    // one that ticks wants update() called regularly even without input.
+    virtual bool isAnimating() const { return false; }
+    virtual bool isTicking() const { return false; }
+    // How often update() should still run while the GUI neither animates nor ticks,
+    // to notice work arriving from other threads; zero for never
+    virtual sf::Time getIdleInterval() const { return sf::Time::Zero; }
+    bool needsRedraw() const { return dirty || isAnimating(); }
+    // Call whenever something on screen changed
+    void invalidate() { dirty = true; }
+    void markDrawn() { dirty = false; }
+
 protected:
     sf::RenderWindow& window;
     MusicPlayer& player;
+
+private:
+    bool dirty = true;
 };
 
 // Existing GUI class, now derived from BaseGUI
 class GUI : public BaseGUI {
 public:
-    GUI(sf::RenderWindow& window, MusicPlayer& player);
-    void handleEvents() override;
+    GUI(sf::RenderWindow& window, MusicPlayer& player, MetadataCache& metadata, WaveformCache& waveforms);
+    void handleEvent(const sf::Event& event) override;
     void update() override;
     void draw() override;
+    bool isAnimating() const override;
+    bool isTicking() const override;
+    sf::Time getIdleInterval() const override;
+    // Picks up tracks the watcher finds added to or removed from the library every update
+    void watchLibrary(LibraryWatcher* watcher);
 
 private:
     // All existing private members and methods remain unchanged
@@ -35,26 +62,40 @@ private:
     void handleMouseMove(const sf::Event::MouseMoveEvent& mouseMove);
     void handleMouseRelease(const sf::Event::MouseButtonEvent& mouseButton);
     void handleTextEntered(const sf::Event::TextEvent& text);
+    void handleKeyPressed(const sf::Event::KeyEvent& key);
+    void handleMouseWheel(const sf::Event::MouseWheelScrollEvent& wheel);
     void drawHomePage();
+    void drawScrollBar();
     void drawNowPlayingPage();
     void drawAnimationBars(const sf::Vector2f& position);
     void drawSearchCursor();
+    void toggleProfilerOverlay();
+    void updateProfilerOverlay();
     void togglePlayPause();
     void toggleShuffle();
     void toggleLoop();
     void setProgressFromMouseClick(float mouseX);
     void setVolumeFromMouseClick(float mouseX);
     void activateSearchBar();
+    void runSearch();
+    void toggleFuzzySearch();
     void deactivateSearchBar();
     void updateProgressBar();
     void updateProgressBarPreview(float mouseX);
+    void updateWaveform();
+    void colorWaveform();
+    void updateSeekPreview(float mouseX);
     void updateVolumeSliderPreview(float mouseX);
     void handleHomePageClick(const sf::Event::MouseButtonEvent& mouseButton);
     void drawOscilloscope();
     void drawSpectrum();
     void drawBars();
+    void updateAnalyzer(SpectrumAnalyzer& analyzer);
     void updateTimeDisplay();
-    std::string formatTime(int seconds);
+    void applyLibraryChanges();
+    // Looks every track up in the metadata cache again, as after it was remapped
+    void resolveMetadata();
+    static std::string formatTime(int seconds);
 
     Page currentPage;
     bool isSearchBarActive;
@@ -72,13 +113,75 @@ private:
     // Other member variables
     sf::Clock clock;
     sf::Clock cursorBlinkClock;
+    bool cursorVisible = false;
     std::string searchQuery;
     std::string currentSong;
-    std::vector<std::string> filteredMusicFiles;
+    std::vector<std::uint32_t> displayedTracks; // Track ids (indices into player.getTracks()) shown on the home page
+    // Searches run off the frame loop; the list shows the previous results until new ones arrive
+    SearchWorker searchWorker;
+    // Tab switches between substring matches in library order and the best fuzzy matches, ranked
+    bool fuzzySearch = false;
+    static constexpr size_t maxFuzzyResults = 100;
+
+    // Virtualized song list; one row shape is reused for every visible row, and the
+    // laid-out texts of recently visible rows are kept by track id
+    struct RowText {
+        sf::Text title, details;
+        float detailsWidth = 0.0f;
+        std::uint64_t lastDrawn = 0;    // frameNumber of the last frame that showed the row
+    };
+    RowText& getRowText(std::uint32_t track);
+    ListLayout songList;
+    sf::View songListView;
+    sf::RectangleShape songRow, scrollThumb;
+    sf::Text songRowText, songRowDetails;   // Style templates for new RowText entries
+    std::unordered_map<std::uint32_t, RowText> rowTexts;
+    std::uint64_t frameNumber = 0;
+    sf::Clock frameClock;
+    std::vector<const TrackMetadata*> trackMetadata; // Indexed like player.getTracks(), null if unknown
+    MetadataCache& metadata;
+    LibraryWatcher* libraryWatcher = nullptr;
+    LibraryChanges libraryChanges;
     static constexpr float barMaxHeight = 20.0f;
     float animationTime = 0.0f;
+    sf::Text songNameText;          // Now Playing title, wrapped once per song
+    std::string songNameSource;     // currentSong that songNameText was built from
+    // What was animating in the last frame drawn, so idle frames can be skipped
+    bool currentRowAnimated = false;
+    bool visualizerActive = false;
+    bool wasLoading = false;
+    int shownPosition = -1, shownDuration = -1; // Whole seconds currently in the time texts
+
+    // Visualizers: the analyzer of the view on screen is fed the latest audio every frame
+    SpectrumAnalyzer barsAnalyzer, spectrumAnalyzer;
+    std::vector<float> recentSamples;
+    sf::Clock analyzerClock;
+    // Rebuilt in place every frame, so each view is a single draw call without allocating
+    sf::VertexArray barsGeometry, spectrumGeometry, oscilloscopeGeometry;
+    std::vector<sf::Vector2f> linePoints;
+
+    // Waveform of the current track on the progress bar, and a close-up of the
+    // seconds around the mouse while it hovers over the bar
+    WaveformCache& waveforms;
+    std::shared_ptr<const PeakPyramid> waveform;    // Null until the thumbnail is ready
+    size_t waveformTrack = static_cast<size_t>(-1);
+    std::vector<Peak> waveformColumns;
+    sf::VertexArray waveformGeometry, seekPreviewGeometry;
+    float waveformFillWidth = -1.0f;    // progressFill width the waveform was colored for
+    bool seekPreviewVisible = false;
+    sf::RectangleShape seekPreviewBackground;
+    sf::Text seekPreviewTime;
 
     // Time display
     sf::Text currentTimeText;
     sf::Text totalTimeText;
+    sf::Text loadingText; // Shown while the player is still switching or seeking
+
+    // Profiler overlay (F3), refreshed a couple of times per second; F4 exports a trace
+    bool profilerOverlayVisible = false;
+    bool overlayEnabledProfiler = false;
+    sf::Text profilerText;
+    sf::RectangleShape profilerBackground;
+    sf::Clock profilerRefreshClock;
+    std::vector<Profiler::Stats> profilerStats;
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// A single audio file found by the scanner
+struct LibraryEntry {
+    std::string path;
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+};
+
+// The sizes and mtimes of the library's files, indexed by track id, for the caches
+// that check their records against them; the paths live in a TrackStore
+struct FileStamps {
+    std::vector<std::uint64_t> sizes;
+    std::vector<std::int64_t> mtimes;
+};
+
+// Recursive, multi-threaded library scanner backed by a persistent index.
+// Every directory is recorded with its mtime; on later scans a directory whose
+// mtime is unchanged is taken from the index instead of being listed again.
+class LibraryScanner {
+public:
+    LibraryScanner(const std::string& rootDirectory, const std::string& indexPath, unsigned int threadCount = 0);
+
+    // Walks the library and returns every supported audio file, sorted by path.
+    // The index is rewritten whenever anything changed.
+    std::vector<LibraryEntry> scan();
+
+    size_t getDirectoriesListed() const { return directoriesListed; }
+    size_t getDirectoriesReused() const { return directoriesReused; }
+
+    static bool isSupportedExtension(const std::string& extension);
+
+    // Entries for a list of files from elsewhere, such as a playlist, in the same order.
+    // Sizes and times are read in parallel; files that cannot be read get zeros.
+    static std::vector<LibraryEntry> statFiles(const std::vector<std::string>& paths, unsigned int threadCount = 0);
+    // The same, but files that cannot be read are left out instead
+    static std::vector<LibraryEntry> statExistingFiles(const std::vector<std::string>& paths, unsigned int threadCount = 0);
+
+private:
+    // Fills entries from paths; readable, if given, is set to 1 for every file that could be read
+    static void statInto(const std::vector<std::string>& paths, std::vector<LibraryEntry>& entries, std::vector<char>* readable,
+        unsigned int threadCount);
+
+    struct FileRecord {
+        std::string name;
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+    };
+
+    struct DirectoryRecord {
+        std::string path;
+        std::int64_t mtime = 0;
+        std::vector<std::string> subdirectories;
+        std::vector<FileRecord> files;
+    };
+
+    bool loadIndex();
+    bool saveIndex(const std::vector<DirectoryRecord>& records) const;
+    bool scanDirectory(const std::string& path, DirectoryRecord& record, bool& reused);
+
+    std::string rootDirectory;
+    std::string indexPath;
+    unsigned int threadCount;
+    std::unordered_map<std::string, DirectoryRecord> index;
+    size_t directoriesListed = 0;
+    size_t directoriesReused = 0;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "LibraryScanner.hpp"
+#include "TrackStore.hpp"
+
+// Tracks that appeared in or left the library since the last batch. Ids stay
+// stable: new tracks are numbered after every id handed out before, so they can
+// simply be appended, and removed tracks keep their ids (as tombstones).
+struct LibraryChanges {
+    size_t firstAddedId = 0;            // Id of added[0]; the rest follow in order
+    std::vector<LibraryEntry> added;
+    std::vector<size_t> removed;
+
+    bool empty() const { return added.empty() && removed.empty(); }
+};
+
+// Follows the Songs directory tree with inotify on a background thread. Creates,
+// deletes and renames are collected per path, so a file that is copied in and
+// deleted again never shows up, and published in batches once events stop for a
+// moment (or at least every second while a bulk copy keeps them coming). A file
+// counts as added once it has been written and closed, not while it is still
+// being copied. If the kernel's event queue overflows, the tree is listed again
+// and compared with what is known.
+// Linux only; elsewhere start() reports that and returns false.
+class LibraryWatcher {
+public:
+    // tracks is the library as it was loaded; it must outlive the watcher and not change
+    LibraryWatcher(const std::string& rootDirectory, const TrackStore& tracks);
+    ~LibraryWatcher();
+    LibraryWatcher(const LibraryWatcher&) = delete;
+    LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+
+    bool start();
+    void stop();
+    bool isWatching() const { return watching; }
+    // True while changes are being collected into a batch or a batch waits to be taken
+    bool hasPendingChanges() const { return collecting || changesReady; }
+
+    // Moves every batch published since the last call into changes. Only takes a
+    // lock for the hand-over, so it is cheap enough to call every frame.
+    bool takeChanges(LibraryChanges& changes);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+    void readEvents();
+    void resync();
+    void markPending(const std::string& path, bool present);
+    // Watches directory and everything below it. Files under it that are not known
+    // become pending additions; known ones are flagged in seen, if given.
+    void watchTree(const std::string& directory, std::vector<bool>* seen);
+    void forgetTree(const std::string& directory);
+    void publish();
+    // Id of the live track at path, or npos
+    size_t findKnown(const std::string& path) const;
+    void addKnown(const std::string& path, size_t id);
+    void eraseKnown(const std::string& path, size_t id);
+    template <typename Function> void forEachKnown(Function function) const;
+
+    std::string rootDirectory;
+    std::atomic<bool> watching{ false };
+    std::atomic<bool> collecting{ false };
+    std::atomic<bool> changesReady{ false };
+    std::thread thread;
+    int inotifyFd = -1;
+    int wakeFds[2] = { -1, -1 };        // Written to by stop()
+
+    // Watcher thread only
+    TrackStore paths;                                   // The library as loaded, plus every track added since
+    // Path hash to id of every live track, hashed on the thread rather than at startup.
+    // The rare path whose hash another one already has goes into collisions instead.
+    std::unordered_map<std::uint64_t, size_t> known;
+    std::unordered_map<std::string, size_t> collisions;
+    std::unordered_map<int, std::string> directories;   // Watch descriptor to directory path
+    std::unordered_map<std::string, bool> pending;      // Path to whether it exists now
+    Clock::time_point firstPending, lastEvent;
+    bool overflowed = false;
+
+    std::mutex mutex;
+    LibraryChanges ready;               // Published and not taken yet
+};
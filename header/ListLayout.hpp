@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+
+// Geometry and scrolling for a virtualized list of fixed-height rows.
+// Only the rows intersecting the viewport are ever asked for, so drawing
+// and hit testing cost the same for a hundred rows as for a million.
+// All positions are in window pixels.
+class ListLayout {
+public:
+    ListLayout(float rowPitch, float rowHeight);
+
+    void setViewport(float top, float height);
+    void setRowCount(size_t count);
+
+    // Scrolling moves a target offset; update() glides the visible offset towards it
+    void scrollBy(float pixels);
+    void scrollToTop();
+    void scrollToBottom();
+    void page(int pages);
+    void ensureVisible(size_t row);
+
+    // Advances the smooth scroll animation. Returns true while it is still moving.
+    bool update(float deltaSeconds);
+    bool isAnimating() const;
+
+    // Visible rows are [getFirstVisibleRow(), getEndVisibleRow())
+    size_t getFirstVisibleRow() const;
+    size_t getEndVisibleRow() const;
+    float getRowTop(size_t row) const;
+    bool getRowAt(float y, size_t& row) const;
+
+    float getViewportTop() const { return viewportTop; }
+    float getViewportHeight() const { return viewportHeight; }
+    float getRowPitch() const { return rowPitch; }
+    float getRowHeight() const { return rowHeight; }
+    size_t getRowCount() const { return rowCount; }
+    double getScrollOffset() const { return scrollOffset; }
+    double getMaxScrollOffset() const;
+
+private:
+    double clampOffset(double offset) const;
+
+    float rowPitch;
+    float rowHeight;
+    float viewportTop = 0.0f;
+    float viewportHeight = 0.0f;
+    size_t rowCount = 0;
+    // Doubles, since a million rows is well past the range floats keep pixel-exact
+    double scrollOffset = 0.0;
+    double targetOffset = 0.0;
+};
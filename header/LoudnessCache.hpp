@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LibraryScanner.hpp"
+#include "TrackStore.hpp"
+
+// Fixed-size record of the loudness log
+struct LoudnessRecord {
+    std::uint64_t pathHash;
+    std::uint64_t size;
+    std::int64_t mtime;
+    float loudness;     // Integrated, in LUFS; -infinity for silence
+    float truePeak;     // Linear, 1.0 being full scale
+};
+static_assert(sizeof(LoudnessRecord) == 32, "LoudnessRecord is part of the cache file format");
+
+// Loudness of every track in the library, measured in the background on a pool
+// of threads and used to play every track at the same perceived level. Results
+// are appended to the log one at a time as tracks finish, so analysis that is
+// interrupted resumes with the tracks still missing. Records for files whose
+// size or mtime changed are ignored and dropped when the log is compacted. Files
+// that cannot be decoded are not recorded, so they are tried again next start.
+// Tracks are identified by their ids in the store given to the constructor, which
+// must outlive the cache and not change, as must the stamps.
+class LoudnessCache {
+public:
+    static constexpr float targetLoudness = -18.0f;     // LUFS
+    static constexpr float peakCeiling = -1.0f;         // dBTP that boosting must not exceed
+
+    LoudnessCache(const std::string& cachePath, const TrackStore& tracks, const FileStamps& stamps);
+    ~LoudnessCache();
+    LoudnessCache(const LoudnessCache&) = delete;
+    LoudnessCache& operator=(const LoudnessCache&) = delete;
+
+    // Reads the log and opens it for appending. The tracks it does not cover are
+    // then measured by start()'s threads, or handed to store() by a decode pass
+    // that reads them anyway (see WaveformCache), so no track is decoded twice.
+    void open();
+    // open(), plus a pool of threads that measures the tracks still missing
+    void start(unsigned int threadCount = 0);
+
+    bool needsMeasuring(size_t track) const;
+    // Records the loudness of a track measured elsewhere, from all of its samples
+    void store(size_t track, float loudness, float truePeak);
+
+    // Linear gain that brings track to targetLoudness; 1 until the track has been measured
+    float getGain(size_t track) const;
+    size_t getMeasuredCount() const;
+
+private:
+    bool load();
+    bool rewrite() const;
+    void work();
+    void initializeRecord(size_t track, LoudnessRecord& record) const;
+    bool measure(size_t track, LoudnessRecord& record) const;
+    void append(size_t track, const LoudnessRecord& record);
+
+    // What a record holds beyond the file's identity, which tracks and stamps give
+    struct Measurement {
+        float loudness;
+        float truePeak;
+    };
+
+    std::string cachePath;
+    const TrackStore& tracks;
+    const FileStamps& stamps;
+
+    mutable std::mutex mutex;
+    std::vector<Measurement> measurements;  // Indexed by track
+    std::vector<bool> measured;
+    std::ofstream log;
+    bool opened = false;
+
+    std::atomic<size_t> nextTrack{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Measures a whole track the way EBU R128 / ITU-R BS.1770 describes: K-weighted
+// mean square over 400 ms blocks overlapping by 75%, gated at -70 LUFS and then
+// 10 LU below the ungated level, plus the true peak found by 4x oversampling.
+// Channels are filtered two at a time in SIMD lanes where SSE2 is available.
+class LoudnessMeter {
+public:
+    LoudnessMeter(unsigned int sampleRate, unsigned int channelCount);
+
+    // Interleaved 16-bit frames, in order
+    void addFrames(const std::int16_t* samples, size_t frameCount);
+
+    // Integrated loudness in LUFS of everything added so far; -infinity for
+    // silence or anything shorter than one block
+    double getIntegratedLoudness() const;
+    // Highest absolute value of the 4x oversampled signal, 1.0 being full scale
+    double getTruePeak() const;
+
+    static double toDecibels(double amplitude);
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    unsigned int channelCount;
+    size_t laneCount;               // channelCount rounded up to whole pairs
+    Biquad shelf, highPass;         // The two stages of the K-weighting filter
+    std::vector<double> filterState;    // z1 and z2 of both stages, per lane
+    std::vector<double> channelWeights; // Per lane; padding lanes weigh nothing
+    std::vector<double> laneEnergy;
+
+    size_t framesPerSubBlock;
+    size_t subBlockFrames = 0;
+    std::vector<double> subBlocks;  // Weighted mean square of each 100 ms step
+
+    std::vector<float> peakHistory; // Last 12 samples of each channel, stored twice for a contiguous window
+    size_t peakPosition = 0;
+    float truePeak = 0.0f;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LibraryScanner.hpp"
+#include "MappedFile.hpp"
+#include "TrackStore.hpp"
+
+// Fixed-size on-disk record. The cache file is a header followed by these
+// records sorted by pathHash, so it can be used straight from the mapping.
+struct TrackMetadata {
+    std::uint64_t pathHash;
+    std::uint64_t size;
+    std::int64_t mtime;
+    float duration;
+    std::uint32_t sampleRate;
+    std::uint16_t channelCount;
+    std::uint16_t year;
+    std::uint32_t trackNumber;
+    char title[96];  // UTF-8, zero terminated
+    char artist[64];
+    char album[64];
+};
+static_assert(sizeof(TrackMetadata) == 264, "TrackMetadata is part of the cache file format");
+
+class MetadataCache {
+public:
+    explicit MetadataCache(const std::string& cachePath);
+    ~MetadataCache();
+    MetadataCache(const MetadataCache&) = delete;
+    MetadataCache& operator=(const MetadataCache&) = delete;
+
+    // Maps the cache file; returns false if it is missing or from another format version
+    bool load();
+
+    // Brings the cache in line with the library: reads metadata for new or
+    // modified files on a pool of threads, drops removed files, then rewrites
+    // and remaps the cache. Files that cannot be read are left out, so they are
+    // tried again next time. Returns the number of files that had to be opened.
+    size_t update(const TrackStore& tracks, const FileStamps& stamps, unsigned int threadCount = 0);
+    // The same on a background thread, so a first run over a large library never
+    // holds up the window. find() keeps answering from the old mapping meanwhile.
+    // tracks and stamps must outlive the update and not change.
+    void startUpdate(const TrackStore& tracks, const FileStamps& stamps, unsigned int threadCount = 0);
+    // Once the background update has written the new cache, maps it in place of the
+    // old one and returns true; every pointer find() returned before is invalid then.
+    // Cheap enough to call every frame.
+    bool takeUpdate();
+    bool isUpdating() const { return updateThread.joinable(); }
+
+    const TrackMetadata* find(const std::string& path) const;
+    size_t size() const { return recordCount; }
+
+private:
+    const TrackMetadata* records() const;
+    const TrackMetadata* findHash(std::uint64_t pathHash) const;
+    // Reads the files that are new or modified into newRecords, sorted by path hash.
+    // Returns false if the cache is up to date already or the cache is being destroyed.
+    bool collect(const TrackStore& tracks, const FileStamps& stamps, unsigned int threadCount, std::vector<TrackMetadata>& newRecords,
+        size_t& openedCount) const;
+    // Writes newRecords next to the cache, for replace() to move over it
+    bool writeTemporary(const std::vector<TrackMetadata>& newRecords) const;
+    bool replace();
+    std::string getTemporaryPath() const { return cachePath + ".tmp"; }
+
+    std::string cachePath;
+    MappedFile file;
+    size_t recordCount = 0;
+
+    std::thread updateThread;
+    std::atomic<bool> updateDone{ false };
+    bool updateWritten = false;         // Set by the update thread before updateDone
+    std::atomic<bool> stopping{ false };
+};
+
+// Reads duration, format and tags for a single file. Returns false if the file cannot be decoded.
+bool readTrackMetadata(const std::string& path, TrackMetadata& metadata);
@@ -6,11 +6,18 @@
 #include <string>
 #include <random>
 #include <algorithm>
+#include <mutex>
+#include "PlaybackStream.hpp"
+#include "TrackLoader.hpp"
+#include "ShuffleOrder.hpp"
+#include "LoudnessCache.hpp"
+#include "DspStages.hpp"
+#include "LibraryWatcher.hpp"
+#include "TrackStore.hpp"
 
 class MusicPlayer {
 public:
-    MusicPlayer(const std::vector<std::string>& files);
-    const sf::Music& getMusic() const { return music; }
+    explicit MusicPlayer(TrackStore library);
     void play();
     void pause();
     void next();
@@ -19,34 +26,83 @@ public:
     void shuffle(bool on);
     void loop(bool on);
     void playSong(size_t index);
+    // Call once per frame. Returns true when playback moved on to the next track by itself.
+    bool update();
+    void setGapless(bool on);
+    bool getIsGapless() const;
+    // Fades each track into the next over this many seconds, at the end of a song and
+    // on next/previous; zero cuts straight across (gapless, if that is on). Looping
+    // songs still repeat without fading.
+    void setCrossfade(float seconds, PlaybackStream::FadeCurve curve = PlaybackStream::FadeCurve::EqualPower);
+    float getCrossfade() const;
+    // True while a song switch, seek or play/pause request is still being carried out
+    bool isLoading() const;
     bool isCurrentSongFinished() const;
     bool hasStartedPlaying() const;
     void setHasStartedPlaying(bool hasStarted);
     float getTotalDuration() const;
     float getPlaybackPosition() const;
     void setPlaybackPosition(float position);
+    // Fills samples with the count most recent mono samples of the playing song, for
+    // visualizers. Returns false, leaving samples untouched, when nothing is audible.
+    bool readRecentSamples(float* samples, size_t count, unsigned int& sampleRate) const;
     float getPlaybackPercentage() const;
 
-    const std::vector<std::string>& getMusicFiles() const {
-        return musicFiles;
+    // Indexed by track id, including tracks that have since been removed
+    const TrackStore& getTracks() const {
+        return tracks;
     }
+    // Appends added tracks and retires removed ones, which are skipped from then on.
+    // A removed track that is playing plays to its end.
+    void updateLibrary(const LibraryChanges& changes);
+    bool isRemoved(size_t index) const { return removed[index] != 0; }
 
     sf::SoundSource::Status getStatus() const;
     size_t getCurrentIndex() const;
     bool getIsShuffled() const;
     bool getIsLooping() const;
     std::string getCurrentSong() const;
+    // Base name of the current song, without the path being rebuilt
+    std::string_view getCurrentName() const { return tracks.getBaseName(currentIndex); }
     float getVolume() const;
     void setVolume(float volume);
+    // Plays every track opened from now on at the gain loudness measured for it; null turns that off
+    void setLoudness(const LoudnessCache* loudness);
+
+    // The effects every track plays through, in this order. Their setters are safe to call at any time.
+    Preamp& getPreamp() { return *preamp; }
+    ParametricEq& getEqualizer() { return *equalizer; }
+    SoftLimiter& getLimiter() { return *limiter; }
 
 private:
-    std::vector<std::string> musicFiles;
-    std::vector<size_t> shuffledIndices;
-    sf::Music music;
+    void openCurrent(bool play, bool crossfade = false);
+    void queueFollowingSong();
+    size_t getFollowingIndex();
+    size_t getPrecedingIndex();
+    float getTrackGain(size_t index) const;
+
+    TrackStore tracks;
+    std::vector<char> removed;      // Per track id
+    ShuffleOrder shuffleOrder;
+    const LoudnessCache* loudness = nullptr;
+    // Files are opened on the loader thread; every call into stream goes through streamMutex
+    PlaybackStream stream;
+    Preamp* preamp;             // Owned by the stream's DspChain
+    ParametricEq* equalizer;
+    SoftLimiter* limiter;
+    mutable std::mutex streamMutex;
+    TrackLoader loader;
     size_t currentIndex;
+    size_t queuedIndex = 0;
+    bool hasQueuedIndex = false;
+    bool wantsPlaying = false;      // Status the pending requests will leave the stream in
+    float pendingPosition = 0.f;    // Position shown until those requests have run
+    mutable float knownDuration = 0.f;  // Of the current track as last read; 0 while a song is opening
+    bool hasOpenSong = false;
+    bool isGapless = true;
+    float crossfadeSeconds = 0.f;
     bool isShuffled;
     bool isLooping;
-    std::mt19937 rng;
     bool startedPlaying = false;
 };
 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lowest and highest sample of a block of audio, scaled to 8 bits
+struct Peak {
+    std::int8_t min = 0;
+    std::int8_t max = 0;
+};
+
+// Min/max peaks of a whole track at several zoom levels. Level 0 has one peak
+// per baseFramesPerPeak frames, and each further level merges levelFactor peaks
+// of the one below, so any range of the track can be drawn at any width by
+// reading about levelFactor peaks per column.
+class PeakPyramid {
+public:
+    static constexpr size_t baseFramesPerPeak = 256;
+    static constexpr size_t levelFactor = 4;
+
+    // Building: feed the decoded track in order as interleaved frames, then call finish()
+    void append(const std::int16_t* samples, size_t frameCount, unsigned int channelCount);
+    void finish();
+
+    // Loading: takes every level as returned by getPeaks() of a finished pyramid of
+    // frameCount frames. Returns false if the peak count does not fit that length.
+    bool assign(std::uint64_t frameCount, std::vector<Peak> peaks);
+
+    std::uint64_t getFrameCount() const { return frameCount; }
+    size_t getLevelCount() const { return levelOffsets.empty() ? 0 : levelOffsets.size() - 1; }
+    // Every level back to back, finest first
+    const std::vector<Peak>& getPeaks() const { return peaks; }
+
+    // Summarizes the part of the track between begin and end (fractions of its
+    // length) into columns.size() equally wide peaks. Columns past the end are silent.
+    void query(double begin, double end, std::vector<Peak>& columns) const;
+
+private:
+    static std::vector<size_t> getLevelOffsets(size_t basePeakCount);
+
+    std::uint64_t frameCount = 0;
+    std::vector<Peak> peaks;
+    std::vector<size_t> levelOffsets;   // Level k is peaks [levelOffsets[k], levelOffsets[k + 1])
+    size_t pendingFrames = 0;           // Frames of the unfinished level 0 peak so far
+    std::int16_t pendingMin = 0, pendingMax = 0;
+};
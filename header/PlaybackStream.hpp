@@ -0,0 +1,138 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+#include "DspChain.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Audio stream that decodes tracks itself instead of going through sf::Music.
+// A second track can be queued ahead of time; its first samples are decoded
+// when it is queued, and when the current track runs out mid-buffer the
+// queued one continues in the same buffer, so there is no gap between tracks.
+// With a crossfade set, both tracks are decoded together instead over the
+// last seconds of the current one and mixed sample by sample.
+class PlaybackStream : public sf::SoundStream {
+public:
+    // Gain of the incoming track over the fade; the outgoing one mirrors it
+    enum class FadeCurve {
+        Linear,     // Gains sum to one; dips in the middle for unrelated material
+        EqualPower, // Sine and cosine, power stays constant; the usual choice
+        SCurve      // Raised cosine: slow at both ends, quick in the middle
+    };
+
+    // A decoder plus the first samples it produced, ready to be spliced in
+    class Track {
+    public:
+        // Opens the file and decodes its first chunk, or prerollDuration of it if
+        // that is longer. trackId is any number the caller uses to recognise the track later.
+        bool open(const std::string& path, size_t trackId, sf::Time prerollDuration = sf::Time::Zero);
+        size_t read(sf::Int16* samples, size_t count);
+        void rewind();
+        void seek(sf::Time offset);
+        // Scales every sample read from now on, e.g. for loudness normalization
+        void setGain(float gain) { this->gain = gain; }
+
+        unsigned int getChannelCount() const { return file.getChannelCount(); }
+        unsigned int getSampleRate() const { return file.getSampleRate(); }
+        sf::Time getDuration() const { return file.getDuration(); }
+        size_t getTrackId() const { return trackId; }
+        // Interleaved samples between the read position and the end
+        sf::Uint64 getRemainingSamples() const;
+
+    private:
+        sf::InputSoundFile file;
+        size_t trackId = 0;
+        std::vector<sf::Int16> preroll;
+        size_t prerollPosition = 0;
+        sf::Uint64 position = 0;    // In interleaved samples from the start of the file
+        float gain = 1.0f;
+    };
+
+    PlaybackStream();
+    ~PlaybackStream() override;
+
+    // Tracks are opened by the caller (typically off the UI thread) and then handed over.
+    // Making a track current stops playback, unless crossfade is asked for and possible:
+    // the stream is playing, a crossfade duration is set and the formats match. The
+    // new track then fades in over the playing one from the next buffer on.
+    void setCurrent(std::unique_ptr<Track> track, bool crossfade = false);
+    // Makes the queued track current; it is already open and primed
+    bool openQueued(bool crossfade = false);
+
+    // Zero turns crossfading off. Applies from the next fade on.
+    void setCrossfade(sf::Time duration, FadeCurve curve);
+    sf::Time getCrossfade() const;
+    // How much of a track to decode when opening it, so a fade can start on time
+    // even if the disk is slow to deliver the rest
+    sf::Time getPrerollDuration() const;
+
+    // Sets the track that should follow the current one
+    void setQueued(std::unique_ptr<Track> track);
+    void clearNext();
+    bool getQueuedTrackId(size_t& trackId) const;
+
+    // True once the play position has crossed into a track that was spliced or
+    // faded in, whose id is then stored in trackId. Reports each change once.
+    // Also releases a track that has finished fading out, so call it regularly.
+    bool takeTrackChange(size_t& trackId);
+
+    sf::Time getTrackDuration() const;
+    sf::Time getTrackOffset() const;
+    void setTrackOffset(sf::Time offset);
+
+    // Copies the count mono samples (channels averaged, scaled to [-1, 1]) that end at
+    // the current play position, oldest first, for visualizers. Samples from before
+    // the last seek or track switch read as silence.
+    void readRecentSamples(float* samples, size_t count) const;
+
+    // Effects applied to everything played. Add stages before the first track is made current;
+    // their own setters can be used at any time.
+    DspChain& getDsp() { return dsp; }
+
+protected:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time timeOffset) override;
+
+private:
+    bool canSplice(const Track& track) const;
+    bool isFading() const { return fadePosition < fadeLength; }
+    bool isReleasing() const { return releasePosition < releaseLength; }
+    size_t mixFade(size_t offset);
+    void mixRelease(size_t count);
+    void tap(const sf::Int16* samples, size_t count);
+    void resetTap(sf::Uint64 position);
+
+    mutable std::mutex mutex;
+    std::unique_ptr<Track> current;
+    std::unique_ptr<Track> queued;
+    std::unique_ptr<Track> outgoing;    // Kept until its last samples have been heard; fades out while isFading()
+    std::unique_ptr<Track> released;    // Left a fade that was turned around; ramps to silence while isReleasing()
+    std::vector<sf::Int16> buffer;
+    std::vector<sf::Int16> fadeBuffer;  // The outgoing track's share of a buffer
+    DspChain dsp;
+
+    // Positions in interleaved samples on the stream's own timeline (see getPlayingOffset)
+    sf::Uint64 decodedPosition = 0;     // Next sample onGetData will hand out
+    sf::Uint64 trackStart = 0;          // Where the audible track began
+    sf::Uint64 splicePosition = 0;      // Where the spliced-in track begins
+    bool splicePending = false;
+
+    sf::Time crossfade;
+    FadeCurve fadeCurve = FadeCurve::EqualPower;
+    // Progress of the running fade, in interleaved samples; equal when none is running
+    sf::Uint64 fadePosition = 0;
+    sf::Uint64 fadeLength = 0;
+    float outgoingGain = 1.0f;          // Level the outgoing track fades out from
+    // The same for the quick ramp of the released track, which starts at releaseGain
+    sf::Uint64 releasePosition = 0;
+    sf::Uint64 releaseLength = 0;
+    float releaseGain = 0.0f;
+
+    // Mono copy of what onGetData handed out last, indexed by frame modulo its size.
+    // It has to cover the buffers queued ahead of the play position plus one analysis window.
+    std::vector<float> tapRing;
+    sf::Uint64 tapEnd = 0;              // Frame after the newest one in tapRing
+    sf::Uint64 tapFill = 0;             // Valid frames ending at tapEnd
+};
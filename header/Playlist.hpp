@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// M3U/M3U8 and PLS playlists. Loading parses a memory mapping of the file line by
+// line and builds each resolved path in place, so a playlist of hundreds of
+// thousands of entries costs one allocation per track and no copy of the file.
+class Playlist {
+public:
+    enum class Format { M3u, Pls };
+
+    // .pls is PLS; anything else (.m3u, .m3u8) is read and written as M3U
+    static Format getFormat(const std::string& path);
+
+    // Appends the local files the playlist lists to tracks, in playlist order.
+    // Relative entries are resolved against the playlist's own directory and
+    // file:// URLs are decoded; other URLs are skipped, and so are files in formats
+    // the scanner would not pick up. Returns false if the playlist cannot be read.
+    static bool load(const std::string& path, std::vector<std::string>& tracks);
+
+    // Writes tracks as UTF-8 M3U (with #EXTM3U header) or PLS, chosen by extension.
+    // Tracks under the playlist's directory are stored relative to it, others as
+    // absolute paths, so the playlist keeps working from any working directory.
+    static bool save(const std::string& path, const std::vector<std::string>& tracks);
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped timers for finding slow frames. PROFILE_SCOPE("name") times the rest of
+// the enclosing block and, while profiling is switched on, records it into a
+// fixed-size lock-free ring that any thread can write to. The newest events are
+// kept; old ones are overwritten. Names must be string literals.
+//
+// While profiling is off a scope costs one relaxed atomic load. Building with
+// MUSICPLAYER_NO_PROFILING removes the scopes entirely.
+class Profiler {
+public:
+    struct Event {
+        const char* name;
+        std::uint32_t thread;       // Small number per thread, in order of first use
+        std::int64_t start;         // Nanoseconds since the profiler started
+        std::int64_t duration;      // Nanoseconds
+    };
+
+    // Timing statistics of one scope name, in milliseconds
+    struct Stats {
+        const char* name;
+        size_t count;
+        double mean, p50, p95, p99, max;
+    };
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on);
+
+    static std::int64_t now();
+    static void record(const char* name, std::int64_t start, std::int64_t duration);
+
+    // Copies the events still in the ring, oldest first
+    static void snapshot(std::vector<Event>& events);
+    // Stats per scope name over the events that started in the last windowNanoseconds
+    static void summarize(std::int64_t windowNanoseconds, std::vector<Stats>& stats);
+    // Writes the ring in Chrome's trace event format (chrome://tracing, Perfetto)
+    static bool exportChromeTrace(const std::string& path);
+
+private:
+    inline static std::atomic<bool> enabled{ false };
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(Profiler::isEnabled() ? name : nullptr), start(this->name ? Profiler::now() : 0) {}
+    ~ProfileScope() {
+        if (name) {
+            Profiler::record(name, start, Profiler::now() - start);
+        }
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    std::int64_t start;
+};
+
+#ifdef MUSICPLAYER_NO_PROFILING
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
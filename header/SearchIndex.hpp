@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "FuzzyMatch.hpp"
+#include "TrackStore.hpp"
+
+// Case-insensitive substring search over track base names.
+// Queries of three or more characters are answered from a trigram index by
+// intersecting posting lists and verifying the few remaining candidates.
+// Results of earlier queries are kept while the user keeps typing, so a
+// query that extends the previous one only narrows the previous result set.
+class SearchIndex {
+public:
+    explicit SearchIndex(const TrackStore& tracks);
+
+    // Indexes the tracks added to tracks since it was last seen here. They are
+    // found by a linear scan until enough have gathered to be worth rebuilding
+    // the trigram index.
+    void add(const TrackStore& tracks);
+    // Leaves id out of every result from now on
+    void remove(std::uint32_t id);
+
+    // Returns the ids (indices into tracks) of matching tracks in ascending order.
+    // The reference stays valid until the next call.
+    const std::vector<std::uint32_t>& search(const std::string& query);
+
+    // Ranks tracks by fuzzy match instead (see FuzzyMatch.hpp) and keeps the best
+    // limit, best first. Scored in parallel on large libraries; not cached.
+    void searchFuzzy(const std::string& query, size_t limit, std::vector<FuzzyMatch>& matches, unsigned int threadCount = 0) const;
+    // The same over ids [begin, end) only, so a long search can be done in steps
+    // and the steps' matches merged with rankFuzzyMatches
+    void searchFuzzy(const std::string& query, size_t limit, size_t begin, size_t end, std::vector<FuzzyMatch>& matches,
+        unsigned int threadCount = 0) const;
+
+    size_t size() const { return offsets.size() - 1; }
+
+private:
+    static std::uint32_t trigramKey(const char* text);
+    void appendNames(const TrackStore& tracks);
+    void buildPostings();
+    bool nameContains(std::uint32_t id, const std::string& query) const;
+    void searchFull(const std::string& query, std::vector<std::uint32_t>& results) const;
+    void appendUnindexed(const std::string& query, std::vector<std::uint32_t>& results) const;
+    void scanAll(const std::string& query, std::vector<std::uint32_t>& results) const;
+
+    std::string names;                   // Lowercased base names, each followed by '\0'
+    std::vector<std::uint32_t> offsets;  // Start of each name in names, plus one past the end
+    std::vector<std::uint32_t> characterMasks;  // getCharacterMask of each name, for fuzzy search
+
+    // Posting lists in compressed form: the ids for trigramKeys[i] are
+    // postings[postingStarts[i] .. postingStarts[i + 1])
+    std::vector<std::uint32_t> trigramKeys;
+    std::vector<std::uint32_t> postingStarts;
+    std::vector<std::uint32_t> postings;
+    std::uint32_t indexedCount = 0;      // Ids below this are in the posting lists
+
+    std::vector<char> removed;           // Per id
+    size_t removedCount = 0;
+
+    // One entry per query the user typed on the way to the current one
+    std::vector<std::pair<std::string, std::vector<std::uint32_t>>> history;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SearchIndex.hpp"
+
+// Runs the search bar's queries on a background thread, so typing never waits for
+// a search. Each submit() supersedes the query before it: a search still running
+// is abandoned at its next step and the newest query is started instead. Fuzzy
+// searches go through the library in slices and publish the best matches so far
+// after each one, so the first results show up long before a large library has
+// been scored; substring searches are answered from the trigram index in one step.
+// The time from submit() to the first published results is recorded as the
+// profiler event "search: first result" (and to the last as "search: complete").
+class SearchWorker {
+public:
+    // fuzzyLimit is how many ranked matches a fuzzy search keeps
+    SearchWorker(const TrackStore& tracks, size_t fuzzyLimit);
+    ~SearchWorker();
+    SearchWorker(const SearchWorker&) = delete;
+    SearchWorker& operator=(const SearchWorker&) = delete;
+
+    void submit(const std::string& query, bool fuzzy);
+
+    // Hands the newest results of the current query over in results if there are
+    // any not taken yet; complete is false while more may follow. Only takes a
+    // lock for the swap, so it is cheap enough to call every frame.
+    bool takeResults(std::vector<std::uint32_t>& results, bool& complete);
+    // True from submit() until the last results have been taken
+    bool isSearching() const;
+
+    // Indexes the tracks added to tracks since the last call and drops removed,
+    // then runs the current query again. Waits for at most one step of a search.
+    void update(const TrackStore& tracks, const std::vector<size_t>& removed);
+
+private:
+    void run();
+    void search(std::uint64_t generation, const std::string& query, bool fuzzy, std::int64_t submitTime);
+    bool isCancelled(std::uint64_t generation) const { return generation != latestGeneration.load(std::memory_order_relaxed); }
+    void publish(std::uint64_t generation, std::vector<std::uint32_t>& ids, bool complete, std::int64_t submitTime);
+
+    std::mutex indexMutex;              // Held by the worker for one step at a time
+    SearchIndex index;
+    size_t fuzzyLimit;
+
+    std::thread thread;
+    std::atomic<std::uint64_t> latestGeneration{ 0 };   // Bumped by every submit() and update()
+
+    mutable std::mutex mutex;           // Guards everything below
+    std::condition_variable wake;
+    bool stopping = false;
+    std::string query;
+    bool fuzzy = false;
+    std::int64_t submitTime = 0;        // Profiler::now() at the last submit()
+    std::uint64_t startedGeneration = 0;
+    std::uint64_t completedGeneration = 0;
+    std::uint64_t resultsGeneration = 0;    // Of results; 0 until the first are published
+    std::vector<std::uint32_t> results;
+    bool resultsComplete = false;
+    bool resultsTaken = true;
+};
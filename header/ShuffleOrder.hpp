@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// A random play order over tracks 0..count-1 with a reverse map from track to
+// position, so stepping forwards or backwards from any track is O(1).
+// The order is an incremental Fisher-Yates shuffle: positions are only drawn
+// when playback first reaches them, which makes reshuffle() O(1) however large
+// the library is.
+class ShuffleOrder {
+public:
+    explicit ShuffleOrder(size_t count = 0, std::uint32_t seed = std::random_device{}());
+
+    // Starts over with count tracks
+    void reset(size_t count);
+    // Adds tracks size()..count-1 to the part of the order not drawn yet, so they
+    // come up later in this pass without disturbing what has already played
+    void grow(size_t count);
+    // Forgets the drawn order; the next positions asked for are drawn afresh
+    void reshuffle();
+
+    size_t size() const { return order.size(); }
+
+    // Tracks before and after track in the order, wrapping around at the ends.
+    // Going backwards from the first position draws the rest of the order once.
+    size_t next(size_t track);
+    size_t previous(size_t track);
+    // Makes track the most recent position of the drawn order (if it is not
+    // drawn yet), so next() continues with fresh tracks from there
+    void playNow(size_t track);
+
+    size_t getTrackAt(size_t position);
+    size_t getPosition(size_t track) const { return position[track]; }
+
+private:
+    void drawThrough(size_t last);
+    void place(size_t track, size_t at);
+
+    std::vector<std::uint32_t> order;       // order[p] is the track at position p
+    std::vector<std::uint32_t> position;    // position[t] is where track t sits in order
+    size_t drawn = 0;                       // Positions [0, drawn) are final
+    std::mt19937 rng;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "FFT.hpp"
+
+// Turns the most recent block of audio into a fixed number of log-spaced
+// frequency bands, each a level between 0 and 1. Levels jump up quickly and
+// fall back slowly so the display stays readable. All buffers are sized in
+// the constructor (and when the sample rate changes), not per frame.
+class SpectrumAnalyzer {
+public:
+    SpectrumAnalyzer(size_t fftSize, size_t bandCount, float minFrequency = 40.0f, float maxFrequency = 16000.0f);
+
+    size_t getFftSize() const { return fft.getSize(); }
+
+    // samples holds getFftSize() mono samples in [-1, 1], oldest first
+    void update(const float* samples, unsigned int sampleRate, float deltaSeconds);
+    // Lets every band fall towards zero, for when nothing is playing
+    void release(float deltaSeconds);
+
+    const std::vector<float>& getLevels() const { return levels; }
+    // True once every band has fallen to (nearly) zero
+    bool isAtRest() const;
+
+private:
+    void mapBands(unsigned int sampleRate);
+
+    RealFFT fft;
+    float minFrequency, maxFrequency;
+    unsigned int mappedSampleRate = 0;
+    std::vector<float> power;
+    std::vector<size_t> bandFirstBin, bandEndBin;   // Bins [first, end) feeding each band
+    std::vector<float> levels;
+};
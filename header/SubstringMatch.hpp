@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Case-insensitive substring search over many names at once.
+// names holds every name already lowercased and followed by '\0';
+// offsets[i] is where name i starts and offsets[count] is one past the end.
+// The query is ASCII case-folded here. Matching ids are appended in ascending order.
+void findMatchingNames(const char* names, const std::uint32_t* offsets, size_t count,
+    const std::string& query, std::vector<std::uint32_t>& matches);
+
+// The individual kernels, exposed for benchmarking. The SSE2/AVX2 variants fall
+// back to the scalar kernel when the instruction set is not available.
+enum class MatchKernel { Scalar, SSE2, AVX2 };
+bool isMatchKernelSupported(MatchKernel kernel);
+void findMatchingNames(MatchKernel kernel, const char* names, const std::uint32_t* offsets, size_t count,
+    const std::string& query, std::vector<std::uint32_t>& matches);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <SFML/System.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "PlaybackStream.hpp"
+
+// Background thread that performs every slow operation on a PlaybackStream:
+// opening files, seeking and switching tracks. Requests are queued and return
+// immediately. A newer request of the same kind replaces one that has not run
+// yet, so hammering "next" only ever opens the last song asked for.
+class TrackLoader {
+public:
+    // streamMutex guards every call into stream; the loader holds it only while
+    // handing a track over, never while a file is being opened
+    TrackLoader(PlaybackStream& stream, std::mutex& streamMutex);
+    ~TrackLoader();
+    TrackLoader(const TrackLoader&) = delete;
+    TrackLoader& operator=(const TrackLoader&) = delete;
+
+    // Makes trackId current, reusing the queued track if it is the same one.
+    // gain scales the track's samples (see PlaybackStream::Track::setGain).
+    // With crossfade, a playing track fades into the new one instead of stopping.
+    void open(size_t trackId, const std::string& path, bool play, float gain = 1.0f, bool crossfade = false);
+    void queueNext(size_t trackId, const std::string& path, float gain = 1.0f);
+    void clearNext();
+    void seek(sf::Time offset);
+    void play();
+    void pause();
+
+    // True while a request that changes what is heard (anything except
+    // queueing the following track) is waiting or running
+    bool isBusy() const;
+
+private:
+    enum class CommandType { Open, Queue, ClearQueue, Seek, Play, Pause };
+
+    struct Command {
+        explicit Command(CommandType type) : type(type) {}
+
+        CommandType type;
+        size_t trackId = 0;
+        std::string path;
+        bool play = false;
+        bool crossfade = false;
+        float gain = 1.0f;
+        sf::Time offset;
+    };
+
+    void post(Command command);
+    void run();
+    void execute(const Command& command);
+    bool isSuperseded(CommandType type) const;
+    static bool isBackground(CommandType type);
+
+    PlaybackStream& stream;
+    std::mutex& streamMutex;
+
+    mutable std::mutex mutex;
+    std::condition_variable commandAvailable;
+    std::deque<Command> commands;
+    bool running = false;   // A command has been taken off the queue and is executing
+    CommandType runningType = CommandType::Open;
+    bool stopping = false;
+    bool hasTrack = false;  // Whether the last open succeeded; only touched by the loader thread
+    std::thread thread;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The library's track paths, indexed by track id. Each distinct directory is stored
+// once and each file name once, in two contiguous arenas; a track is three small
+// integers into them. On a large library that is several times smaller than a
+// std::string per path, and walking every name touches one block of memory.
+// Views returned stay valid until the next add().
+// A store can extend another one that no longer changes: the base's ids are read
+// from it and add() numbers after them. That way the library as loaded is shared,
+// read-only, by threads such as the caches' workers while the player appends to it.
+class TrackStore {
+public:
+    TrackStore() = default;
+    explicit TrackStore(const std::vector<std::string>& paths);
+    // base must outlive this store and must not be added to any more
+    explicit TrackStore(const TrackStore* base);
+
+    void reserve(size_t count);
+    // Gives back the slack of the arenas' geometric growth once loading is done
+    void shrinkToFit();
+    // Appends path as the next id
+    void add(std::string_view path);
+
+    size_t size() const { return baseCount + directoryIds.size(); }
+    bool empty() const { return size() == 0; }
+
+    // Up to and including the last separator; empty for a bare file name
+    std::string_view getDirectory(size_t id) const;
+    std::string_view getFileName(size_t id) const;
+    // File name without its extension, as getBaseName() returns it
+    std::string_view getBaseName(size_t id) const;
+    // From the last dot of the file name on (".mp3"); empty if there is none
+    std::string_view getExtension(size_t id) const;
+    // The path exactly as it was added
+    std::string getPath(size_t id) const;
+    void getPath(size_t id, std::string& path) const;
+
+    // Neither counts what the base holds
+    size_t getDirectoryCount() const { return directoryStarts.size() - 1; }
+    // Bytes held, including unused capacity
+    size_t getMemoryUsage() const;
+
+private:
+    std::uint32_t internDirectory(std::string_view directory);
+    std::string_view getDirectoryAt(std::uint32_t index) const;
+    void growSlots();
+
+    const TrackStore* base = nullptr;
+    size_t baseCount = 0;                               // Ids below this are the base's
+
+    std::string directories;                            // Distinct directories back to back
+    std::vector<std::uint32_t> directoryStarts{ 0 };    // Start of each in directories, plus one past the end
+    // Open-addressing hash table of directory index + 1 (0 is an empty slot)
+    std::vector<std::uint32_t> directorySlots;
+    std::uint32_t lastDirectory = 0;                    // Scans list a directory's files together
+
+    // Per track, kept as separate arrays so scans only load what they use
+    std::string names;                                  // File names back to back
+    std::vector<std::uint32_t> nameStarts{ 0 };         // Start of each in names, plus one past the end
+    std::vector<std::uint32_t> directoryIds;
+    std::vector<std::uint16_t> extensionLengths;
+};
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 std::string getBaseName(const std::string& path);
 std::string wrapText(const std::string& text, unsigned int lineLength);
-void filterMusicFiles(const std::vector<std::string>& musicFiles, const std::string& query, std::vector<std::string>& filtered);
\ No newline at end of file
+void filterMusicFiles(const std::vector<std::string>& musicFiles, const std::string& query, std::vector<std::string>& filtered);
+std::uint64_t hashPath(std::string_view path);
+// Bytes of the whole process currently in RAM; 0 where that cannot be read
+size_t getResidentMemory();
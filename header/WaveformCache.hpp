@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "LibraryScanner.hpp"
+#include "LoudnessCache.hpp"
+#include "PeakPyramid.hpp"
+#include "TrackStore.hpp"
+
+// Waveform thumbnails for the library. A pool of threads decodes each track once,
+// faster than real time, and stores its PeakPyramid as <directory>/<path hash>.peaks,
+// tagged with the file's size and mtime so edited files are decoded again.
+// Tracks are identified by their ids in the store given to the constructor, which
+// match the player's; the store and the stamps must outlive the cache and not change.
+// Given an opened LoudnessCache, the same decode also measures each track's
+// loudness, so the library is decoded once for both and by one pool of threads.
+class WaveformCache {
+public:
+    WaveformCache(const std::string& directory, const TrackStore& tracks, const FileStamps& stamps, LoudnessCache* loudness = nullptr,
+        unsigned int threadCount = 0);
+    ~WaveformCache();
+    WaveformCache(const WaveformCache&) = delete;
+    WaveformCache& operator=(const WaveformCache&) = delete;
+
+    // Lets the workers go through the whole library in the background,
+    // decoding every track that has no thumbnail on disk yet
+    void prefetchAll();
+
+    // The thumbnail of track if it is in memory. Otherwise it is queued ahead of
+    // everything else and null is returned; ask again on a later frame.
+    std::shared_ptr<const PeakPyramid> get(size_t track);
+
+private:
+    enum class TrackState : std::uint8_t { Unknown, Working, OnDisk, Failed };
+
+    void work();
+    std::string getCachePath(size_t track) const;
+    bool isOnDisk(size_t track) const;
+    bool load(size_t track, PeakPyramid& pyramid) const;
+    // Decodes track once, into pyramid unless it is null and into the loudness cache if measure is set
+    bool decode(size_t track, PeakPyramid* pyramid, bool measure) const;
+    bool save(size_t track, const PeakPyramid& pyramid) const;
+
+    std::string directory;
+    const TrackStore& tracks;
+    const FileStamps& stamps;
+    LoudnessCache* loudness;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<TrackState> states;
+    std::vector<bool> wanted;       // Asked for by get() but not in memory yet
+    std::deque<size_t> requests;    // Most recent get() first
+    size_t nextPrefetch = 0;
+    size_t prefetchEnd = 0;
+    // Recently asked for thumbnails, least recently used first
+    std::vector<std::pair<size_t, std::shared_ptr<const PeakPyramid>>> loaded;
+    std::atomic<bool> stopping{ false };
+    std::vector<std::thread> workers;
+};
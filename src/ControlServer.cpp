@@ -0,0 +1,332 @@
+#include "../header/ControlServer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t maxRequestLength = 4096;
+const size_t maxSearchResults = 50;
+const int pollTimeoutMilliseconds = 100; // Also how often finished songs are noticed
+
+#ifdef MSG_NOSIGNAL
+const int sendFlags = MSG_NOSIGNAL; // A client hanging up must not kill the daemon with SIGPIPE
+#else
+const int sendFlags = 0;
+#endif
+
+const char* describeStatus(const MusicPlayer& player) {
+    if (player.isLoading()) {
+        return "loading";
+    }
+    switch (player.getStatus()) {
+    case sf::SoundSource::Playing:
+        return "playing";
+    case sf::SoundSource::Paused:
+        return "paused";
+    default:
+        return "stopped";
+    }
+}
+
+bool parseIndex(const std::string& text, size_t count, size_t& index) {
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || value >= count) {
+        return false;
+    }
+    index = static_cast<size_t>(value);
+    return true;
+}
+
+} // namespace
+
+ControlServer::ControlServer(MusicPlayer& player, const std::string& socketPath)
+    : player(player), socketPath(socketPath) {}
+
+ControlServer::~ControlServer() {
+#ifndef _WIN32
+    for (const Client& client : clients) {
+        close(client.socket);
+    }
+    if (listener != -1) {
+        close(listener);
+        unlink(socketPath.c_str());
+    }
+#endif
+}
+
+void ControlServer::applyLibraryChanges() {
+    player.updateLibrary(libraryChanges);
+    if (!searchIndex) {
+        return; // Built from the updated library when first needed
+    }
+    searchIndex->add(player.getTracks());
+    for (size_t track : libraryChanges.removed) {
+        searchIndex->remove(static_cast<std::uint32_t>(track));
+    }
+}
+
+SearchIndex& ControlServer::getSearchIndex() {
+    if (!searchIndex) {
+        searchIndex = std::make_unique<SearchIndex>(player.getTracks());
+        for (size_t track = 0; track < player.getTracks().size(); ++track) {
+            if (player.isRemoved(track)) {
+                searchIndex->remove(static_cast<std::uint32_t>(track));
+            }
+        }
+    }
+    return *searchIndex;
+}
+
+void ControlServer::advancePlayback() {
+    // The same bookkeeping GUI::update does every frame
+    if (libraryWatcher && libraryWatcher->takeChanges(libraryChanges)) {
+        applyLibraryChanges();
+    }
+    player.update();
+    if (player.hasStartedPlaying() && player.isCurrentSongFinished()) {
+        player.next();
+    }
+}
+
+void ControlServer::handle(const std::string& request, std::string& response) {
+    std::string command = request.substr(0, request.find(' '));
+    std::string argument = command.size() < request.size() ? request.substr(command.size() + 1) : std::string();
+    char buffer[64];
+
+    if (command == "play") {
+        size_t index;
+        if (!argument.empty()) {
+            if (!parseIndex(argument, player.getTracks().size(), index) || player.isRemoved(index)) {
+                response = "ERR no such track\n";
+                return;
+            }
+            player.playSong(index);
+        }
+        else if (!player.hasStartedPlaying()) {
+            player.playSong(player.getCurrentIndex());
+        }
+        player.play();
+        response = "OK\n";
+    }
+    else if (command == "pause") {
+        player.pause();
+        response = "OK\n";
+    }
+    else if (command == "next" || command == "prev") {
+        if (command == "next") {
+            player.next();
+        }
+        else {
+            player.previous();
+        }
+        player.setHasStartedPlaying(true);
+        std::snprintf(buffer, sizeof(buffer), "OK %zu\n", player.getCurrentIndex());
+        response = buffer;
+    }
+    else if (command == "seek") {
+        char* end = nullptr;
+        float position = std::strtof(argument.c_str(), &end);
+        if (argument.empty() || *end != '\0' || position < 0) {
+            response = "ERR expected seconds\n";
+            return;
+        }
+        player.setPlaybackPosition(position);
+        response = "OK\n";
+    }
+    else if (command == "search") {
+        const std::vector<std::uint32_t>& matches = getSearchIndex().search(argument);
+        std::snprintf(buffer, sizeof(buffer), "OK %zu\n", matches.size());
+        response = buffer;
+        for (size_t i = 0; i < std::min(matches.size(), maxSearchResults); ++i) {
+            response += std::to_string(matches[i]) + ' ';
+            response += player.getTracks().getBaseName(matches[i]);
+            response += '\n';
+        }
+    }
+    else if (command == "fuzzy") {
+        std::vector<FuzzyMatch> matches;
+        getSearchIndex().searchFuzzy(argument, maxSearchResults, matches);
+        std::snprintf(buffer, sizeof(buffer), "OK %zu\n", matches.size());
+        response = buffer;
+        for (const auto& match : matches) {
+            response += std::to_string(match.id) + ' ';
+            response += player.getTracks().getBaseName(match.id);
+            response += '\n';
+        }
+    }
+    else if (command == "status") {
+        std::snprintf(buffer, sizeof(buffer), "OK %s %zu %.1f %.1f ", describeStatus(player), player.getCurrentIndex(),
+            player.getPlaybackPosition(), player.getTotalDuration());
+        response = buffer;
+        response += player.getCurrentName();
+        response += '\n';
+    }
+    else if (command == "quit") {
+        stopping = true;
+        response = "OK\n";
+    }
+    else {
+        response = "ERR unknown command\n";
+    }
+}
+
+#ifdef _WIN32
+
+bool ControlServer::run() {
+    std::cerr << "Headless mode needs Unix domain sockets, which this build does not support." << std::endl;
+    return false;
+}
+
+#else
+
+bool ControlServer::listen() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << socketPath << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1) {
+        std::cerr << "Error creating control socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(socketPath.c_str()); // Left behind by a daemon that did not shut down cleanly
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || ::listen(listener, 16) == -1) {
+        std::cerr << "Error listening on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void ControlServer::accept() {
+    int socket;
+    while ((socket = ::accept(listener, nullptr, nullptr)) != -1) {
+        fcntl(socket, F_SETFL, O_NONBLOCK);
+        clients.push_back({ socket, std::string(), std::string(), false });
+    }
+}
+
+bool ControlServer::readFrom(Client& client) {
+    char buffer[4096];
+    while (true) {
+        ssize_t received = recv(client.socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            client.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received == 0) {
+            client.finished = true; // Half-closed; its requests still get answered below
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        break;
+    }
+
+    // Answer every complete line
+    size_t lineStart = 0;
+    size_t lineEnd;
+    std::string response;
+    while ((lineEnd = client.input.find('\n', lineStart)) != std::string::npos) {
+        std::string request = client.input.substr(lineStart, lineEnd - lineStart);
+        if (!request.empty() && request.back() == '\r') {
+            request.pop_back();
+        }
+        handle(request, response);
+        client.output += response;
+        lineStart = lineEnd + 1;
+    }
+    client.input.erase(0, lineStart);
+    return client.input.size() <= maxRequestLength;
+}
+
+bool ControlServer::writeTo(Client& client) {
+    while (!client.output.empty()) {
+        ssize_t sent = send(client.socket, client.output.data(), client.output.size(), sendFlags);
+        if (sent > 0) {
+            client.output.erase(0, static_cast<size_t>(sent));
+        }
+        else if (sent == -1 && errno == EINTR) {
+            continue;
+        }
+        else {
+            return sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    return true;
+}
+
+bool ControlServer::run() {
+    if (!listen()) {
+        return false;
+    }
+    std::cout << "Listening on " << socketPath << std::endl;
+
+    std::vector<pollfd> descriptors;
+    while (!stopping) {
+        descriptors.clear();
+        descriptors.push_back({ listener, POLLIN, 0 });
+        for (const Client& client : clients) {
+            short events = client.finished ? 0 : POLLIN;
+            if (!client.output.empty()) {
+                events |= POLLOUT;
+            }
+            descriptors.push_back({ client.socket, events, 0 });
+        }
+
+        if (poll(descriptors.data(), descriptors.size(), pollTimeoutMilliseconds) == -1 && errno != EINTR) {
+            std::cerr << "Error waiting on control socket: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // Clients are served in the order they were polled; new ones join the next round
+        for (size_t i = 0; i < clients.size(); ++i) {
+            const pollfd& descriptor = descriptors[i + 1];
+            Client& client = clients[i];
+            bool open = true;
+            if (descriptor.revents & (POLLIN | POLLHUP | POLLERR)) {
+                open = readFrom(client);
+            }
+            if (open) {
+                open = writeTo(client) && !(client.finished && client.output.empty());
+            }
+            if (!open) {
+                close(client.socket);
+                client.socket = -1;
+            }
+        }
+        // Dropped once every client has been served, so the indices above stay in step with descriptors
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& client) { return client.socket == -1; }), clients.end());
+        if (descriptors[0].revents & POLLIN) {
+            accept();
+        }
+
+        advancePlayback();
+    }
+    return true;
+}
+
+#endif
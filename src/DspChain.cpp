@@ -0,0 +1,92 @@
+#include "../header/DspChain.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DSP_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void DspChain::add(std::unique_ptr<DspStage> stage) {
+    stages.push_back(std::move(stage));
+}
+
+void DspChain::prepare(unsigned int sampleRate, unsigned int channelCount, size_t maxSamples) {
+    this->channelCount = channelCount;
+    // Whole frames, so a block never splits one between channels
+    size_t frames = channelCount ? std::max<size_t>(1, maxSamples / channelCount) : 0;
+    buffer.assign(frames * channelCount, 0.0f);
+    for (auto& stage : stages) {
+        stage->prepare(sampleRate, channelCount);
+    }
+}
+
+void DspChain::reset() {
+    for (auto& stage : stages) {
+        stage->reset();
+    }
+}
+
+bool DspChain::isNeutral() const {
+    return std::all_of(stages.begin(), stages.end(), [](const std::unique_ptr<DspStage>& stage) {
+        return stage->isNeutral();
+    });
+}
+
+void DspChain::process(std::int16_t* samples, size_t count) {
+    if (buffer.empty() || isNeutral()) {
+        return;
+    }
+    PROFILE_SCOPE("DspChain::process");
+    // Blocks longer than the buffer are done a buffer at a time
+    while (count > 0) {
+        size_t block = std::min(count, buffer.size());
+        toFloat(samples, buffer.data(), block);
+        for (auto& stage : stages) {
+            stage->process(buffer.data(), block / channelCount);
+        }
+        toInt16(buffer.data(), samples, block);
+        samples += block;
+        count -= block;
+    }
+}
+
+void DspChain::toFloat(const std::int16_t* samples, float* out, size_t count) {
+    const float scale = 1.0f / 32768.0f;
+    size_t i = 0;
+#ifdef DSP_HAS_SSE2
+    const __m128 scales = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        // Sign-extend by placing each sample in the top half of a 32-bit lane and shifting back down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scales));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scales));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = samples[i] * scale;
+    }
+}
+
+void DspChain::toInt16(const float* samples, std::int16_t* out, size_t count) {
+    size_t i = 0;
+#ifdef DSP_HAS_SSE2
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    // Clamped first: out of range conversions would come back as INT_MIN whatever the sign
+    const __m128 lowest = _mm_set1_ps(-32768.0f);
+    const __m128 highest = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128 low = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(samples + i), scale), lowest), highest);
+        __m128 high = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(samples + i + 4), scale), lowest), highest);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+#endif
+    for (; i < count; ++i) {
+        float scaled = std::min(32767.0f, std::max(-32768.0f, samples[i] * 32768.0f));
+        out[i] = static_cast<std::int16_t>(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+    }
+}
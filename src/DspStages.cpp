@@ -0,0 +1,221 @@
+#include "../header/DspStages.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DSP_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+float toLinear(float decibels) {
+    return std::pow(10.0f, decibels / 20.0f);
+}
+
+} // namespace
+
+Preamp::Preamp(float decibels) : decibels(decibels), gain(toLinear(decibels)) {}
+
+void Preamp::setGain(float value) {
+    decibels.store(value, std::memory_order_relaxed);
+    gain.store(toLinear(value), std::memory_order_relaxed);
+}
+
+void Preamp::prepare(unsigned int, unsigned int channelCount) {
+    this->channelCount = channelCount;
+}
+
+void Preamp::process(float* samples, size_t frameCount) {
+    // A plain loop the compiler vectorizes on its own
+    const float factor = gain.load(std::memory_order_relaxed);
+    const size_t count = frameCount * channelCount;
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] *= factor;
+    }
+}
+
+ParametricEq::ParametricEq(size_t bandCount)
+    : bands(bandCount), appliedBands(bandCount), coefficients(bandCount) {
+    for (size_t i = 0; i < bandCount; ++i) {
+        bands[i].frequency = 31.25f * static_cast<float>(1 << std::min<size_t>(i, 20));
+        bands[i].shape = i == 0 ? Shape::LowShelf : i + 1 == bandCount ? Shape::HighShelf : Shape::Peaking;
+    }
+}
+
+void ParametricEq::setBand(size_t index, const Band& band) {
+    std::lock_guard<std::mutex> lock(bandsMutex);
+    if (index >= bands.size()) {
+        return;
+    }
+    bands[index] = band;
+    flat.store(std::all_of(bands.begin(), bands.end(), [](const Band& b) { return b.gain == 0.0f; }), std::memory_order_relaxed);
+    bandsVersion.fetch_add(1, std::memory_order_release);
+}
+
+ParametricEq::Band ParametricEq::getBand(size_t index) const {
+    std::lock_guard<std::mutex> lock(bandsMutex);
+    return index < bands.size() ? bands[index] : Band();
+}
+
+void ParametricEq::prepare(unsigned int sampleRate, unsigned int channelCount) {
+    this->sampleRate = sampleRate;
+    this->channelCount = channelCount;
+    laneCount = (channelCount + 1) / 2 * 2;
+    state.assign(bands.size() * laneCount * 2, 0.0);
+    {
+        std::lock_guard<std::mutex> lock(bandsMutex);
+        appliedBands = bands;
+        appliedVersion = bandsVersion.load(std::memory_order_acquire);
+    }
+    updateCoefficients();
+}
+
+void ParametricEq::reset() {
+    std::fill(state.begin(), state.end(), 0.0);
+}
+
+void ParametricEq::updateCoefficients() {
+    activeBands = 0;
+    for (const Band& band : appliedBands) {
+        if (band.gain == 0.0f) {
+            continue;
+        }
+        // RBJ audio EQ cookbook
+        double frequency = std::min<double>(band.frequency, sampleRate * 0.45);
+        double a = std::pow(10.0, band.gain / 40.0);
+        double w0 = 2.0 * pi * frequency / sampleRate;
+        double cosine = std::cos(w0);
+        double alpha = std::sin(w0) / (2.0 * std::max(0.1f, band.q));
+        double b0, b1, b2, a0, a1, a2;
+        switch (band.shape) {
+        case Shape::LowShelf: {
+            double root = 2.0 * std::sqrt(a) * alpha;
+            b0 = a * ((a + 1) - (a - 1) * cosine + root);
+            b1 = 2 * a * ((a - 1) - (a + 1) * cosine);
+            b2 = a * ((a + 1) - (a - 1) * cosine - root);
+            a0 = (a + 1) + (a - 1) * cosine + root;
+            a1 = -2 * ((a - 1) + (a + 1) * cosine);
+            a2 = (a + 1) + (a - 1) * cosine - root;
+            break;
+        }
+        case Shape::HighShelf: {
+            double root = 2.0 * std::sqrt(a) * alpha;
+            b0 = a * ((a + 1) + (a - 1) * cosine + root);
+            b1 = -2 * a * ((a - 1) + (a + 1) * cosine);
+            b2 = a * ((a + 1) + (a - 1) * cosine - root);
+            a0 = (a + 1) - (a - 1) * cosine + root;
+            a1 = 2 * ((a - 1) - (a + 1) * cosine);
+            a2 = (a + 1) - (a - 1) * cosine - root;
+            break;
+        }
+        default:
+            b0 = 1 + alpha * a;
+            b1 = -2 * cosine;
+            b2 = 1 - alpha * a;
+            a0 = 1 + alpha / a;
+            a1 = -2 * cosine;
+            a2 = 1 - alpha / a;
+            break;
+        }
+        coefficients[activeBands++] = { b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0 };
+    }
+}
+
+void ParametricEq::process(float* samples, size_t frameCount) {
+    // Take new settings if the other side is not holding them right now; otherwise next block
+    if (bandsVersion.load(std::memory_order_acquire) != appliedVersion && bandsMutex.try_lock()) {
+        std::copy(bands.begin(), bands.end(), appliedBands.begin());
+        appliedVersion = bandsVersion.load(std::memory_order_relaxed);
+        bandsMutex.unlock();
+        updateCoefficients();
+    }
+
+    // Transposed direct form II in double, one band over the whole block at a time so its state stays in registers
+    for (size_t band = 0; band < activeBands; ++band) {
+        const Coefficients& c = coefficients[band];
+        double* z = state.data() + band * laneCount * 2;
+        for (size_t lane = 0; lane < laneCount; lane += 2) {
+            bool pair = lane + 1 < channelCount;
+            float* sample = samples + lane;
+#ifdef DSP_HAS_SSE2
+            if (pair) {
+                const __m128d b0 = _mm_set1_pd(c.b0), b1 = _mm_set1_pd(c.b1), b2 = _mm_set1_pd(c.b2);
+                const __m128d a1 = _mm_set1_pd(c.a1), a2 = _mm_set1_pd(c.a2);
+                __m128d z1 = _mm_loadu_pd(z + lane * 2);
+                __m128d z2 = _mm_loadu_pd(z + lane * 2 + 2);
+                for (size_t frame = 0; frame < frameCount; ++frame, sample += channelCount) {
+                    __m128d x = _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(sample))));
+                    __m128d y = _mm_add_pd(_mm_mul_pd(b0, x), z1);
+                    z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), z2);
+                    z2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+                    _mm_store_sd(reinterpret_cast<double*>(sample), _mm_castps_pd(_mm_cvtpd_ps(y)));
+                }
+                _mm_storeu_pd(z + lane * 2, z1);
+                _mm_storeu_pd(z + lane * 2 + 2, z2);
+                continue;
+            }
+#endif
+            // Scalar lanes: the odd channel out, or everything without SSE2
+            for (size_t channel = 0; channel < (pair ? 2u : 1u); ++channel) {
+                double z1 = z[lane * 2 + channel];
+                double z2 = z[lane * 2 + 2 + channel];
+                float* s = sample + channel;
+                for (size_t frame = 0; frame < frameCount; ++frame, s += channelCount) {
+                    double x = *s;
+                    double y = c.b0 * x + z1;
+                    z1 = c.b1 * x - c.a1 * y + z2;
+                    z2 = c.b2 * x - c.a2 * y;
+                    *s = static_cast<float>(y);
+                }
+                z[lane * 2 + channel] = z1;
+                z[lane * 2 + 2 + channel] = z2;
+            }
+        }
+    }
+
+    // State decaying through silence would otherwise sink into denormals, which are very slow to compute with
+    for (size_t i = 0; i < activeBands * laneCount * 2; ++i) {
+        if (std::fabs(state[i]) < 1e-30) {
+            state[i] = 0.0;
+        }
+    }
+}
+
+SoftLimiter::SoftLimiter(float thresholdDecibels, float kneeDecibels, float releaseMilliseconds)
+    : threshold(toLinear(thresholdDecibels)), kneeDecibels(kneeDecibels), releaseMilliseconds(releaseMilliseconds) {}
+
+void SoftLimiter::setThreshold(float decibels) {
+    threshold.store(toLinear(decibels), std::memory_order_relaxed);
+}
+
+void SoftLimiter::prepare(unsigned int sampleRate, unsigned int channelCount) {
+    this->channelCount = channelCount;
+    releaseCoefficient = std::exp(-1000.0f / (releaseMilliseconds * std::max(1u, sampleRate)));
+    gain = 1.0f;
+}
+
+void SoftLimiter::process(float* samples, size_t frameCount) {
+    const float ceiling = threshold.load(std::memory_order_relaxed);
+    const float knee = ceiling * toLinear(-kneeDecibels);
+    for (size_t frame = 0; frame < frameCount; ++frame, samples += channelCount) {
+        float peak = 0.0f;
+        for (unsigned int channel = 0; channel < channelCount; ++channel) {
+            peak = std::max(peak, std::fabs(samples[channel]));
+        }
+        // Gain that puts this frame's peak on the knee curve, which approaches the ceiling but never reaches it
+        float target = 1.0f;
+        if (peak > knee) {
+            float bent = ceiling > knee ? knee + (ceiling - knee) * std::tanh((peak - knee) / (ceiling - knee)) : ceiling;
+            target = bent / peak;
+        }
+        gain = target < gain ? target : target + (gain - target) * releaseCoefficient;
+        if (gain != 1.0f) {
+            for (unsigned int channel = 0; channel < channelCount; ++channel) {
+                samples[channel] *= gain;
+            }
+        }
+    }
+}
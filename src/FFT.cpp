@@ -0,0 +1,120 @@
+#include "../header/FFT.hpp"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FFT_HAS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+unsigned int log2Of(size_t value) {
+    unsigned int bits = 0;
+    while ((size_t(1) << bits) < value) {
+        ++bits;
+    }
+    return bits;
+}
+
+} // namespace
+
+RealFFT::RealFFT(size_t size)
+    : size(size), half(size / 2), window(size), bitReversed(size / 2),
+      twiddleRe(size / 2), twiddleIm(size / 2), unpackRe(size / 2), unpackIm(size / 2),
+      re(size / 2), im(size / 2) {
+    for (size_t i = 0; i < size; ++i) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / size));
+    }
+
+    unsigned int bits = log2Of(half);
+    for (size_t i = 0; i < half; ++i) {
+        std::uint32_t reversed = 0;
+        for (unsigned int bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1u) << (bits - 1 - bit);
+        }
+        bitReversed[i] = reversed;
+    }
+
+    for (size_t span = 1; span < half; span *= 2) {
+        for (size_t j = 0; j < span; ++j) {
+            double angle = -pi * j / span;
+            twiddleRe[span - 1 + j] = static_cast<float>(std::cos(angle));
+            twiddleIm[span - 1 + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    for (size_t k = 0; k < half; ++k) {
+        double angle = -2.0 * pi * k / size;
+        unpackRe[k] = static_cast<float>(std::cos(angle));
+        unpackIm[k] = static_cast<float>(std::sin(angle));
+    }
+}
+
+void RealFFT::butterflies() {
+    // Radix-2 decimation in time over split real/imaginary arrays
+    for (size_t span = 1; span < half; span *= 2) {
+        const float* wr = twiddleRe.data() + span - 1;
+        const float* wi = twiddleIm.data() + span - 1;
+        for (size_t start = 0; start < half; start += 2 * span) {
+            float* ar = re.data() + start;
+            float* ai = im.data() + start;
+            float* br = ar + span;
+            float* bi = ai + span;
+            size_t j = 0;
+#ifdef FFT_HAS_SSE
+            // From span 4 on, four butterflies of a block share one set of loads
+            for (; j + 4 <= span; j += 4) {
+                __m128 twr = _mm_loadu_ps(wr + j);
+                __m128 twi = _mm_loadu_ps(wi + j);
+                __m128 xr = _mm_loadu_ps(br + j);
+                __m128 xi = _mm_loadu_ps(bi + j);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(twr, xr), _mm_mul_ps(twi, xi));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(twr, xi), _mm_mul_ps(twi, xr));
+                __m128 yr = _mm_loadu_ps(ar + j);
+                __m128 yi = _mm_loadu_ps(ai + j);
+                _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+                _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+            }
+#endif
+            for (; j < span; ++j) {
+                float tr = wr[j] * br[j] - wi[j] * bi[j];
+                float ti = wr[j] * bi[j] + wi[j] * br[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+void RealFFT::powerSpectrum(const float* input, float* power) {
+    // Pack even samples as real and odd samples as imaginary parts, already in bit-reversed order
+    for (size_t i = 0; i < half; ++i) {
+        std::uint32_t target = bitReversed[i];
+        re[target] = input[2 * i] * window[2 * i];
+        im[target] = input[2 * i + 1] * window[2 * i + 1];
+    }
+
+    butterflies();
+
+    // Separate the spectra of the even and odd samples and combine them into the real spectrum
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    power[half] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (size_t k = 1; k < half; ++k) {
+        float ar = re[k], ai = im[k];
+        float br = re[half - k], bi = -im[half - k];
+        float evenRe = 0.5f * (ar + br);
+        float evenIm = 0.5f * (ai + bi);
+        // -i * (a - b) / 2
+        float oddRe = 0.5f * (ai - bi);
+        float oddIm = -0.5f * (ar - br);
+        float xr = evenRe + unpackRe[k] * oddRe - unpackIm[k] * oddIm;
+        float xi = evenIm + unpackRe[k] * oddIm + unpackIm[k] * oddRe;
+        power[k] = xr * xr + xi * xi;
+    }
+}
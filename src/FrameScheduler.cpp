@@ -0,0 +1,110 @@
+#include "../header/FrameScheduler.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+
+namespace {
+
+// Periodic updates while audio plays but nothing animates: enough for the
+// progress bar and clock, and to notice a finished song promptly
+const sf::Time tickInterval = sf::milliseconds(100);
+// How often input is checked while waiting for a deadline
+const sf::Time pollInterval = sf::milliseconds(4);
+// The same while idle. SFML 2 cannot wait for an event with a timeout, and its
+// waitEvent() checks this often internally, so this wakes no more than blocking would
+const sf::Time idlePollInterval = sf::milliseconds(10);
+
+} // namespace
+
+FrameScheduler::FrameScheduler(sf::RenderWindow& window, BaseGUI& gui, unsigned int maxFramesPerSecond)
+    : window(window), gui(gui), frameInterval(sf::seconds(1.0f / std::max(1u, maxFramesPerSecond))) {}
+
+void FrameScheduler::dispatch(const sf::Event& event) {
+    PROFILE_SCOPE("GUI::handleEvent");
+    if (event.type == sf::Event::Resized) {
+        // SFML has no minimize event; a minimized window reports a zero size on the platforms that tell us at all
+        minimized = event.size.width == 0 || event.size.height == 0;
+        gui.invalidate();
+    }
+    else if (event.type == sf::Event::GainedFocus) {
+        minimized = false;
+        gui.invalidate();
+    }
+    gui.handleEvent(event);
+}
+
+bool FrameScheduler::wantsFrame() const {
+    return !minimized && gui.needsRedraw();
+}
+
+sf::Time FrameScheduler::getDeadline() const {
+    if (wantsFrame()) {
+        return lastFrame + frameInterval;
+    }
+    return lastTick + tickInterval;
+}
+
+void FrameScheduler::run() {
+    while (window.isOpen()) {
+        sf::Event event;
+        if (!wantsFrame() && !gui.isTicking()) {
+            sf::Time idleInterval = gui.getIdleInterval();
+            if (idleInterval == sf::Time::Zero) {
+                // Nothing changes on screen until the user does something
+                if (window.waitEvent(event)) {
+                    dispatch(event);
+                }
+            }
+            else {
+                // Wait for input, but run an update once the idle interval is up
+                sf::Time deadline = lastTick + idleInterval;
+                sf::Time now = clock.getElapsedTime();
+                while (now < deadline && window.isOpen()) {
+                    if (window.pollEvent(event)) {
+                        dispatch(event);
+                        break;
+                    }
+                    sf::sleep(std::min(idlePollInterval, deadline - now));
+                    now = clock.getElapsedTime();
+                }
+            }
+        }
+        else {
+            sf::Time now = clock.getElapsedTime();
+            while (now < getDeadline() && window.isOpen()) {
+                if (window.pollEvent(event)) {
+                    dispatch(event);
+                }
+                else {
+                    sf::sleep(std::min(pollInterval, getDeadline() - now));
+                }
+                now = clock.getElapsedTime();
+            }
+        }
+
+        while (window.pollEvent(event)) {
+            dispatch(event);
+        }
+        if (!window.isOpen()) {
+            break;
+        }
+
+        // A frame is the update and draw of one iteration that drew something
+        std::int64_t frameStart = Profiler::isEnabled() ? Profiler::now() : 0;
+        {
+            PROFILE_SCOPE("GUI::update");
+            gui.update();
+        }
+        lastTick = clock.getElapsedTime();
+        if (wantsFrame()) {
+            {
+                PROFILE_SCOPE("GUI::draw");
+                gui.draw();
+            }
+            gui.markDrawn();
+            lastFrame = lastTick;
+            if (frameStart != 0) {
+                Profiler::record("frame", frameStart, Profiler::now() - frameStart);
+            }
+        }
+    }
+}
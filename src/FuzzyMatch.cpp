@@ -0,0 +1,308 @@
+#include "../header/FuzzyMatch.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace {
+
+// Weights as in fzf's default scheme
+const int scoreMatch = 16;
+const int scoreGapStart = -3;
+const int scoreGapExtension = -1;
+const int bonusBoundaryWhite = 10;  // Word start after a space, or at the start of the name
+const int bonusBoundaryDelimiter = 9;
+const int bonusBoundary = 8;
+const int bonusNonWord = 8;
+const int bonusNumber = 7;          // Digits right after letters ("track12")
+const int bonusConsecutive = 4;
+const int bonusFirstCharMultiplier = 2;
+
+enum class CharClass { White, Delimiter, NonWord, Letter, Number };
+
+CharClass classifyCharacter(char c) {
+    if (c >= 'a' && c <= 'z') {
+        return CharClass::Letter;
+    }
+    if (c >= '0' && c <= '9') {
+        return CharClass::Number;
+    }
+    if (static_cast<unsigned char>(c) >= 0x80) {
+        return CharClass::Letter; // Part of a UTF-8 sequence
+    }
+    switch (c) {
+    case ' ':
+    case '\t':
+        return CharClass::White;
+    case '-':
+    case '_':
+    case '.':
+    case ',':
+    case ':':
+    case ';':
+    case '/':
+    case '|':
+        return CharClass::Delimiter;
+    default:
+        return CharClass::NonWord;
+    }
+}
+
+// Looked up for every character of every scored window
+struct ClassTable {
+    CharClass classes[256];
+    ClassTable() {
+        for (int c = 0; c < 256; ++c) {
+            classes[c] = classifyCharacter(static_cast<char>(c));
+        }
+    }
+};
+const ClassTable classTable;
+
+CharClass classify(char c) {
+    return classTable.classes[static_cast<unsigned char>(c)];
+}
+
+int bonusFor(CharClass previous, CharClass current) {
+    if (current == CharClass::Letter || current == CharClass::Number) {
+        switch (previous) {
+        case CharClass::White:
+            return bonusBoundaryWhite;
+        case CharClass::Delimiter:
+            return bonusBoundaryDelimiter;
+        case CharClass::NonWord:
+            return bonusBoundary;
+        case CharClass::Letter:
+            return current == CharClass::Number ? bonusNumber : 0;
+        case CharClass::Number:
+            return 0;
+        }
+    }
+    return bonusNonWord;
+}
+
+// fzf's first algorithm: take the first occurrence of the term as a subsequence,
+// then walk back from its end to the latest start, which gives the tightest
+// window ending there, and score that window
+bool scoreTerm(std::string_view name, const std::string& term, int& score) {
+    const char* data = name.data();
+    const char* end = data + name.size();
+    const char* p = data;
+    const char* last = nullptr;
+    for (char c : term) {
+        last = static_cast<const char*>(std::memchr(p, c, static_cast<size_t>(end - p)));
+        if (!last) {
+            return false;
+        }
+        p = last + 1;
+    }
+
+    size_t stop = static_cast<size_t>(last - data);
+    size_t start = stop;
+    for (size_t i = stop + 1, t = term.size(); i-- > 0;) {
+        if (data[i] == term[t - 1] && --t == 0) {
+            start = i;
+            break;
+        }
+    }
+
+    CharClass previous = start > 0 ? classify(data[start - 1]) : CharClass::White;
+    int total = 0;
+    int consecutive = 0;
+    int firstBonus = 0;
+    bool inGap = false;
+    size_t t = 0;
+    for (size_t i = start; i <= stop; ++i) {
+        CharClass current = classify(data[i]);
+        if (t < term.size() && data[i] == term[t]) {
+            int bonus = bonusFor(previous, current);
+            if (consecutive == 0) {
+                firstBonus = bonus;
+            }
+            else {
+                // A run keeps the bonus of the boundary it started on
+                if (bonus >= bonusBoundary && bonus > firstBonus) {
+                    firstBonus = bonus;
+                }
+                bonus = std::max({ bonus, firstBonus, bonusConsecutive });
+            }
+            total += scoreMatch + (t == 0 ? bonus * bonusFirstCharMultiplier : bonus);
+            inGap = false;
+            ++consecutive;
+            ++t;
+        }
+        else {
+            total += inGap ? scoreGapExtension : scoreGapStart;
+            inGap = true;
+            consecutive = 0;
+            firstBonus = 0;
+        }
+        previous = current;
+    }
+    score += total;
+    return true;
+}
+
+// The most a term can score: every character matched at a word start
+int getMaximumScore(const std::string& term) {
+    return static_cast<int>(term.size()) * (scoreMatch + bonusBoundaryWhite) + bonusBoundaryWhite * (bonusFirstCharMultiplier - 1);
+}
+
+// True if a ranks before b
+bool isBetter(const FuzzyMatch& a, const FuzzyMatch& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    if (a.length != b.length) {
+        return a.length < b.length;
+    }
+    return a.id < b.id;
+}
+
+// Keeps the best limit matches; the worst of them sits at the front
+class TopK {
+public:
+    explicit TopK(size_t limit) : limit(limit) {
+        heap.reserve(limit);
+    }
+
+    void offer(const FuzzyMatch& candidate) {
+        if (heap.size() < limit) {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end(), isBetter);
+        }
+        else if (isBetter(candidate, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), isBetter);
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end(), isBetter);
+        }
+    }
+
+    // Once full, only a candidate ranking before the worst kept one gets in
+    bool rejects(const FuzzyMatch& candidate) const {
+        return heap.size() == limit && !isBetter(candidate, heap.front());
+    }
+
+    std::vector<FuzzyMatch> heap;
+
+private:
+    size_t limit;
+};
+
+std::vector<std::string> splitTerms(const std::string& query) {
+    std::vector<std::string> terms;
+    std::string term;
+    for (char c : query) {
+        if (c == ' ' || c == '\t') {
+            if (!term.empty()) {
+                terms.push_back(std::move(term));
+                term.clear();
+            }
+        }
+        else {
+            term += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+    }
+    if (!term.empty()) {
+        terms.push_back(std::move(term));
+    }
+    // Longest first: it is the one most likely to rule a name out
+    std::stable_sort(terms.begin(), terms.end(), [](const std::string& a, const std::string& b) {
+        return a.size() > b.size();
+    });
+    return terms;
+}
+
+} // namespace
+
+std::uint32_t getCharacterMask(std::string_view text) {
+    std::uint32_t mask = 0;
+    for (char c : text) {
+        if (c >= 'a' && c <= 'z') {
+            mask |= 1u << (c - 'a');
+        }
+        else if (c >= '0' && c <= '9') {
+            mask |= 1u << (26 + (c - '0') % 6);
+        }
+    }
+    return mask;
+}
+
+bool scoreFuzzy(std::string_view name, const std::vector<std::string>& terms, int& score) {
+    score = 0;
+    for (const auto& term : terms) {
+        if (!scoreTerm(name, term, score)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void findFuzzyMatches(const char* names, const std::uint32_t* offsets, const std::uint32_t* masks, size_t count, const char* skip,
+    const std::string& query, size_t limit, std::vector<FuzzyMatch>& matches, unsigned int threadCount) {
+    PROFILE_SCOPE("findFuzzyMatches");
+    matches.clear();
+    std::vector<std::string> terms = splitTerms(query);
+    if (terms.empty() || limit == 0 || count == 0) {
+        return;
+    }
+    std::uint32_t queryMask = 0;
+    int maximumScore = 0;
+    for (const auto& term : terms) {
+        queryMask |= getCharacterMask(term);
+        maximumScore += getMaximumScore(term);
+    }
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Workers take chunks of names, so one slow stretch does not hold the others up.
+    // A library of one chunk is scored on the calling thread alone.
+    const size_t chunkSize = 16384;
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    size_t workerCount = std::min<size_t>(threadCount, chunks);
+    std::vector<TopK> best(workerCount, TopK(limit));
+    std::atomic<size_t> nextChunk{ 0 };
+    auto worker = [&](TopK& top) {
+        for (size_t begin; (begin = nextChunk.fetch_add(chunkSize)) < count;) {
+            size_t end = std::min(begin + chunkSize, count);
+            for (size_t id = begin; id < end; ++id) {
+                if ((skip && skip[id]) || (masks && (queryMask & ~masks[id]) != 0)) {
+                    continue;
+                }
+                std::string_view name(names + offsets[id], offsets[id + 1] - offsets[id] - 1);
+                // Skip the scoring when even a perfect score would not make the cut
+                if (top.rejects({ static_cast<std::uint32_t>(id), maximumScore, static_cast<std::uint32_t>(name.size()) })) {
+                    continue;
+                }
+                int score;
+                if (scoreFuzzy(name, terms, score)) {
+                    top.offer({ static_cast<std::uint32_t>(id), score, static_cast<std::uint32_t>(name.size()) });
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back(worker, std::ref(best[i]));
+    }
+    worker(best[0]);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    matches = std::move(best[0].heap);
+    for (size_t i = 1; i < workerCount; ++i) {
+        matches.insert(matches.end(), best[i].heap.begin(), best[i].heap.end());
+    }
+    rankFuzzyMatches(matches, limit);
+}
+
+void rankFuzzyMatches(std::vector<FuzzyMatch>& matches, size_t limit) {
+    size_t kept = std::min(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + static_cast<std::ptrdiff_t>(kept), matches.end(), isBetter);
+    matches.resize(kept);
+}
@@ -1,13 +1,70 @@
 #include "../header/GUI.hpp"
+#include "../header/Profiler.hpp"
 #include "../header/Utilities.hpp"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
-#include <iomanip>
-#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+
+const sf::Color visualizerColor(29, 185, 84);
+const sf::Color unplayedWaveformColor(150, 150, 150);
+const sf::Color fuzzySearchColor(120, 200, 255);   // Query text while fuzzy search is on
+
+// Extrudes a polyline into a triangle strip of the given thickness. Each point is
+// pushed out along the average normal of its two segments, so joints stay closed.
+void buildThickLine(sf::VertexArray& strip, const std::vector<sf::Vector2f>& points, float thickness, sf::Color color) {
+    strip.setPrimitiveType(sf::TriangleStrip);
+    strip.resize(points.size() * 2);
+    for (size_t i = 0; i < points.size(); ++i) {
+        sf::Vector2f previous = points[i > 0 ? i - 1 : i];
+        sf::Vector2f next = points[i + 1 < points.size() ? i + 1 : i];
+        sf::Vector2f direction = next - previous;
+        float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+        sf::Vector2f normal = length > 0 ? sf::Vector2f(-direction.y / length, direction.x / length) : sf::Vector2f(0, 1);
+        sf::Vector2f offset = normal * (thickness / 2);
+        strip[i * 2] = sf::Vertex(points[i] - offset, color);
+        strip[i * 2 + 1] = sf::Vertex(points[i] + offset, color);
+    }
+}
 
-GUI::GUI(sf::RenderWindow& window, MusicPlayer& player)
-    : BaseGUI(window, player), currentPage(Page::Home), isSearchBarActive(false), clickedSongIndex(-1) {
+// One vertical line per column from its lowest to its highest sample, filling area.
+// Silent columns still get a one pixel line so the track's length stays visible.
+void buildWaveform(sf::VertexArray& lines, const std::vector<Peak>& columns, const sf::FloatRect& area, sf::Color color) {
+    lines.setPrimitiveType(sf::Lines);
+    lines.resize(columns.size() * 2);
+    float center = area.top + area.height / 2;
+    float scale = area.height / 2 / 128.0f;
+    float step = area.width / columns.size();
+    for (size_t i = 0; i < columns.size(); ++i) {
+        float x = area.left + (i + 0.5f) * step;
+        float top = center - columns[i].max * scale;
+        float bottom = center - columns[i].min * scale;
+        if (bottom - top < 1.0f) {
+            top = center - 0.5f;
+            bottom = center + 0.5f;
+        }
+        lines[i * 2] = sf::Vertex(sf::Vector2f(x, top), color);
+        lines[i * 2 + 1] = sf::Vertex(sf::Vector2f(x, bottom), color);
+    }
+}
+
+const float seekPreviewSeconds = 5.0f;  // Shown either side of the hovered position
+const sf::Vector2f seekPreviewSize(240.0f, 64.0f);
+
+} // namespace
+
+GUI::GUI(sf::RenderWindow& window, MusicPlayer& player, MetadataCache& metadata, WaveformCache& waveforms)
+    : BaseGUI(window, player), currentPage(Page::Home), isSearchBarActive(false), clickedSongIndex(-1),
+      searchWorker(player.getTracks(), maxFuzzyResults), songList(60.0f, 50.0f), metadata(metadata),
+      barsAnalyzer(2048, 30), spectrumAnalyzer(2048, 120), recentSamples(2048), waveforms(waveforms) {
+    resolveMetadata();
+    // Every track, in library order, without waiting for the worker
+    displayedTracks.resize(player.getTracks().size());
+    std::iota(displayedTracks.begin(), displayedTracks.end(), 0u);
     initializeGUI();
 }
 
@@ -80,6 +137,11 @@ void GUI::initializeGUI() {
     progressFill.setPosition(progressBar.getPosition());
     progressFill.setFillColor(sf::Color(29, 185, 84));
 
+    seekPreviewBackground.setSize(seekPreviewSize);
+    seekPreviewBackground.setFillColor(sf::Color(35, 35, 35));
+    seekPreviewBackground.setOutlineColor(sf::Color(80, 80, 80));
+    seekPreviewBackground.setOutlineThickness(1.0f);
+
     volumeSliderBackground.setSize(sf::Vector2f(120.0f, 10.0f));
     volumeSliderBackground.setPosition(120.0f, windowHeight - 53.0f);
     volumeSliderBackground.setFillColor(sf::Color(60, 60, 60));
@@ -96,10 +158,30 @@ void GUI::initializeGUI() {
     currentTimeText.setCharacterSize(20);
     currentTimeText.setFillColor(sf::Color::White);
 
+    seekPreviewTime.setFont(font);
+    seekPreviewTime.setCharacterSize(14);
+    seekPreviewTime.setFillColor(sf::Color::White);
+
     totalTimeText.setFont(font);
     totalTimeText.setCharacterSize(20);
     totalTimeText.setFillColor(sf::Color::White);
 
+    songNameText.setFont(font);
+    songNameText.setCharacterSize(60);
+    songNameText.setFillColor(sf::Color::White);
+
+    profilerText.setFont(font);
+    profilerText.setCharacterSize(14);
+    profilerText.setFillColor(sf::Color::White);
+    profilerText.setPosition(310.0f, 70.0f);
+    profilerBackground.setPosition(300.0f, 60.0f);
+    profilerBackground.setFillColor(sf::Color(0, 0, 0, 200));
+
+    loadingText.setFont(font);
+    loadingText.setCharacterSize(16);
+    loadingText.setFillColor(sf::Color(179, 179, 179));
+    loadingText.setString("Loading...");
+
     updateTimeDisplay();
 
     // Set up text
@@ -126,6 +208,26 @@ void GUI::initializeGUI() {
         sidebarTexts.push_back(text);
     }
 
+    // Song list: rows scroll between the top of the content area and the time labels above the progress bar
+    float listTop = 60.0f;
+    float listHeight = progressBar.getPosition().y - 40.0f - listTop;
+    songList.setViewport(listTop, listHeight);
+    songListView.reset(sf::FloatRect(sidebarWidth, listTop, windowWidth - sidebarWidth, listHeight));
+    songListView.setViewport(sf::FloatRect(sidebarWidth / windowWidth, listTop / windowHeight,
+        (windowWidth - sidebarWidth) / windowWidth, listHeight / windowHeight));
+
+    songRow.setSize(sf::Vector2f(windowWidth - 220.0f, songList.getRowHeight()));
+
+    songRowText.setFont(font);
+    songRowText.setCharacterSize(30);
+    songRowText.setFillColor(sf::Color::White);
+
+    songRowDetails.setFont(font);
+    songRowDetails.setCharacterSize(22);
+    songRowDetails.setFillColor(sf::Color(180, 180, 180));
+
+    scrollThumb.setFillColor(sf::Color(110, 110, 110));
+
     // Initialize animation bars
     for (int i = 0; i < 3; ++i) {
         sf::RectangleShape bar;
@@ -145,9 +247,20 @@ void GUI::updateTimeDisplay() {
 
             int currentSeconds = static_cast<int>(currentPosition);
             int totalSeconds = static_cast<int>(totalDuration);
+            // Labels only change once a second, so most frames stop here
+            if (currentSeconds == shownPosition && totalSeconds == shownDuration) {
+                return;
+            }
+            invalidate();
 
-            currentTimeText.setString(formatTime(currentSeconds));
-            totalTimeText.setString(formatTime(totalSeconds));
+            if (currentSeconds != shownPosition) {
+                currentTimeText.setString(formatTime(currentSeconds));
+            }
+            if (totalSeconds != shownDuration) {
+                totalTimeText.setString(formatTime(totalSeconds));
+            }
+            shownPosition = currentSeconds;
+            shownDuration = totalSeconds;
 
             // Position the time texts
             currentTimeText.setPosition(progressBar.getPosition().x - currentTimeText.getLocalBounds().width - 10,
@@ -159,38 +272,43 @@ void GUI::updateTimeDisplay() {
 
 
 std::string GUI::formatTime(int seconds) {
-    int minutes = seconds / 60;
-    int remainingSeconds = seconds % 60;
-    std::stringstream ss;
-    ss << std::setfill('0') << std::setw(2) << minutes << ":"
-        << std::setfill('0') << std::setw(2) << remainingSeconds;
-    return ss.str();
-}
-
-void GUI::handleEvents() {
-    sf::Event event;
-    while (window.pollEvent(event)) {
-        if (event.type == sf::Event::Closed) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%02d:%02d", seconds / 60, seconds % 60);
+    return buffer;
+}
+
+void GUI::handleEvent(const sf::Event& event) {
+    // Any input may change what is shown
+    invalidate();
+    if (event.type == sf::Event::Closed) {
+        window.close();
+    }
+    else if (event.type == sf::Event::KeyPressed) {
+        if (event.key.code == sf::Keyboard::Escape) {
             window.close();
         }
-        else if (event.type == sf::Event::KeyPressed) {
-            if (event.key.code == sf::Keyboard::Escape) {
-                window.close();
-            }
-        }
-        else if (event.type == sf::Event::MouseButtonPressed) {
-            handleMouseClick(event.mouseButton);
-        }
-        else if (event.type == sf::Event::MouseMoved) {
-            handleMouseMove(event.mouseMove);
-        }
-        else if (event.type == sf::Event::MouseButtonReleased) {
-            handleMouseRelease(event.mouseButton);
-        }
-        else if (event.type == sf::Event::TextEntered && isSearchBarActive) {
-            handleTextEntered(event.text);
+        else {
+            handleKeyPressed(event.key);
         }
     }
+    else if (event.type == sf::Event::MouseButtonPressed) {
+        handleMouseClick(event.mouseButton);
+    }
+    else if (event.type == sf::Event::MouseWheelScrolled) {
+        handleMouseWheel(event.mouseWheelScroll);
+    }
+    else if (event.type == sf::Event::MouseMoved) {
+        handleMouseMove(event.mouseMove);
+    }
+    else if (event.type == sf::Event::MouseLeft) {
+        seekPreviewVisible = false;
+    }
+    else if (event.type == sf::Event::MouseButtonReleased) {
+        handleMouseRelease(event.mouseButton);
+    }
+    else if (event.type == sf::Event::TextEntered && isSearchBarActive) {
+        handleTextEntered(event.text);
+    }
 }
 
 void GUI::handleMouseClick(const sf::Event::MouseButtonEvent& mouseButton) {
@@ -200,13 +318,13 @@ void GUI::handleMouseClick(const sf::Event::MouseButtonEvent& mouseButton) {
     else if (nextButton.getGlobalBounds().contains(mouseButton.x, mouseButton.y)) {
         player.next();
         playPauseButton.setTexture(pauseTexture);
-        currentSong = getBaseName(player.getCurrentSong());
+        currentSong = player.getCurrentName();
         clickedSongIndex = player.getCurrentIndex();
     }
     else if (prevButton.getGlobalBounds().contains(mouseButton.x, mouseButton.y)) {
         player.previous();
         playPauseButton.setTexture(pauseTexture);
-        currentSong = getBaseName(player.getCurrentSong());
+        currentSong = player.getCurrentName();
         clickedSongIndex = player.getCurrentIndex();
     }
     else if (shuffleButton.getGlobalBounds().contains(mouseButton.x, mouseButton.y)) {
@@ -240,9 +358,14 @@ void GUI::handleMouseClick(const sf::Event::MouseButtonEvent& mouseButton) {
 }
 
 void GUI::handleMouseMove(const sf::Event::MouseMoveEvent& mouseMove) {
-    if (progressBar.getGlobalBounds().contains(mouseMove.x, mouseMove.y) && player.getStatus() == sf::SoundSource::Playing) {
+    bool overProgressBar = progressBar.getGlobalBounds().contains(mouseMove.x, mouseMove.y);
+    if (overProgressBar && player.getStatus() == sf::SoundSource::Playing) {
         updateProgressBarPreview(mouseMove.x);
     }
+    seekPreviewVisible = false;
+    if (overProgressBar) {
+        updateSeekPreview(mouseMove.x);
+    }
     if (volumeSliderBackground.getGlobalBounds().contains(mouseMove.x, mouseMove.y)) {
         updateVolumeSliderPreview(mouseMove.x);
     }
@@ -258,22 +381,139 @@ void GUI::handleTextEntered(const sf::Event::TextEvent& text) {
     if (text.unicode == 8 && !searchQuery.empty()) { // Backspace
         searchQuery.pop_back();
     }
-    else if (text.unicode < 128 && text.unicode != 8) {
+    else if (text.unicode < 128 && text.unicode != 8 && text.unicode != '\t') { // Tab switches the search mode
         searchQuery += static_cast<char>(text.unicode);
     }
     searchText.setString(searchQuery);
-    filterMusicFiles(player.getMusicFiles(), searchQuery, filteredMusicFiles);
+    runSearch();
+    songList.scrollToTop();
+}
+
+void GUI::runSearch() {
+    searchWorker.submit(searchQuery, fuzzySearch);
+}
+
+void GUI::toggleFuzzySearch() {
+    fuzzySearch = !fuzzySearch;
+    searchText.setFillColor(fuzzySearch ? fuzzySearchColor : sf::Color::White);
+    if (!isSearchBarActive && searchQuery.empty()) {
+        search.setString(fuzzySearch ? "Fuzzy search" : "Search");
+    }
+    runSearch();
+    songList.scrollToTop();
+}
+
+void GUI::watchLibrary(LibraryWatcher* watcher) {
+    libraryWatcher = watcher;
+}
+
+void GUI::applyLibraryChanges() {
+    PROFILE_SCOPE("GUI::applyLibraryChanges");
+    player.updateLibrary(libraryChanges);
+    for (const auto& entry : libraryChanges.added) {
+        trackMetadata.push_back(metadata.find(entry.path)); // Usually null until the cache is rebuilt
+    }
+    for (size_t track : libraryChanges.removed) {
+        rowTexts.erase(static_cast<std::uint32_t>(track));
+    }
+    // Runs the search the user typed again; the scroll position is kept
+    searchWorker.update(player.getTracks(), libraryChanges.removed);
+    invalidate();
+}
+
+void GUI::resolveMetadata() {
+    // Resolve every track against the mapped cache once, rows then just index into this
+    const TrackStore& tracks = player.getTracks();
+    trackMetadata.clear();
+    trackMetadata.reserve(tracks.size());
+    std::string path;
+    for (size_t track = 0; track < tracks.size(); ++track) {
+        tracks.getPath(track, path);
+        trackMetadata.push_back(metadata.find(path));
+    }
 }
 
 void GUI::update() {
+    if (libraryWatcher && libraryWatcher->takeChanges(libraryChanges)) {
+        applyLibraryChanges();
+    }
+    // Files new to the cache get their artist and duration once the background update is in
+    if (metadata.takeUpdate()) {
+        resolveMetadata();
+        rowTexts.clear();
+        invalidate();
+    }
+    bool searchComplete;
+    if (searchWorker.takeResults(displayedTracks, searchComplete)) {
+        invalidate();
+    }
+    if (player.update()) {
+        // A gapless transition happened on the audio thread; catch the display up with it
+        currentSong = player.getCurrentName();
+        clickedSongIndex = player.getCurrentIndex();
+        invalidate();
+    }
     if (player.hasStartedPlaying() && player.isCurrentSongFinished()) {
         player.next();
         playPauseButton.setTexture(pauseTexture);
-        currentSong = getBaseName(player.getCurrentSong());
+        currentSong = player.getCurrentName();
         clickedSongIndex = player.getCurrentIndex();
+        invalidate();
+    }
+    if (songList.update(frameClock.restart().asSeconds())) {
+        invalidate();
     }
+
+    bool isLoading = player.isLoading();
+    if (isLoading != wasLoading) {
+        wasLoading = isLoading;
+        invalidate();
+    }
+
+    bool cursorOn = isSearchBarActive && std::fmod(cursorBlinkClock.getElapsedTime().asSeconds(), 1.0f) < 0.5f;
+    if (cursorOn != cursorVisible) {
+        cursorVisible = cursorOn;
+        invalidate();
+    }
+
+    if (profilerOverlayVisible && profilerRefreshClock.getElapsedTime().asSeconds() >= 0.5f) {
+        updateProfilerOverlay();
+        invalidate();
+    }
+
+    updateWaveform();
+
+    float fillWidth = progressFill.getSize().x;
     updateProgressBar();
-    updateTimeDisplay();  // Add this line if it's not already there
+    if (progressFill.getSize().x != fillWidth) {
+        invalidate();
+    }
+    updateTimeDisplay();
+}
+
+bool GUI::isAnimating() const {
+    // Frame-rate updates pick streamed search results up as soon as they are published
+    if (songList.isAnimating() || searchWorker.isSearching()) {
+        return true;
+    }
+    switch (currentPage) {
+    case Page::Home:
+        return currentRowAnimated;
+    case Page::NowPlaying:
+        return visualizerActive;
+    }
+    return false;
+}
+
+bool GUI::isTicking() const {
+    return player.getStatus() == sf::SoundSource::Playing || player.isLoading() || isSearchBarActive || profilerOverlayVisible
+        || (libraryWatcher && libraryWatcher->hasPendingChanges()) || metadata.isUpdating()
+        || (player.hasStartedPlaying() && player.isCurrentSongFinished());
+}
+
+sf::Time GUI::getIdleInterval() const {
+    // A watched library can start changing at any time; once it does, isTicking takes over
+    return libraryWatcher && libraryWatcher->isWatching() ? sf::seconds(1) : sf::Time::Zero;
 }
 
 void GUI::draw() {
@@ -303,7 +543,13 @@ void GUI::draw() {
     }
 
     window.draw(progressBar);
-    window.draw(progressFill);
+    if (waveform) {
+        colorWaveform();
+        window.draw(waveformGeometry);
+    }
+    else {
+        window.draw(progressFill);
+    }
 
     if (clickedSongIndex != -1) {
         window.draw(currentTimeText);
@@ -312,9 +558,21 @@ void GUI::draw() {
     window.draw(currentTimeText);
     window.draw(totalTimeText);
 
+    if (player.isLoading()) {
+        loadingText.setPosition(progressBar.getPosition().x + (progressBar.getSize().x - loadingText.getLocalBounds().width) / 2,
+            progressBar.getPosition().y - loadingText.getLocalBounds().height - 10);
+        window.draw(loadingText);
+    }
+
     window.draw(volumeSliderBackground);
     window.draw(volumeFill);
 
+    if (seekPreviewVisible) {
+        window.draw(seekPreviewBackground);
+        window.draw(seekPreviewGeometry);
+        window.draw(seekPreviewTime);
+    }
+
     switch (currentPage) {
     case Page::Home:
         drawHomePage();
@@ -324,58 +582,146 @@ void GUI::draw() {
         break;
     }
 
+    if (profilerOverlayVisible) {
+        window.draw(profilerBackground);
+        window.draw(profilerText);
+    }
+
     window.display();
 }
 
-void GUI::drawHomePage() {
-    const auto& displayFiles = searchQuery.empty() ? player.getMusicFiles() : filteredMusicFiles;
-    for (size_t i = 0; i < displayFiles.size(); ++i) {
-        sf::RectangleShape songButton(sf::Vector2f(window.getSize().x - 220.0f, 50.0f));
-        songButton.setPosition(300.0f, 60.0f + i * 60.0f);
-        songButton.setFillColor(sf::Color(70, 70, 70));
-
-        // Find the index of this song in the original music files
- 
-       auto it = std::find(player.getMusicFiles().begin(), player.getMusicFiles().end(), displayFiles[i]);
-        if (it != player.getMusicFiles().end()) {
-            size_t originalIndex = std::distance(player.getMusicFiles().begin(), it);
-            if (originalIndex == clickedSongIndex) {
-                songButton.setFillColor(sf::Color::Red);
-            }
-        }
+void GUI::toggleProfilerOverlay() {
+    profilerOverlayVisible = !profilerOverlayVisible;
+    if (profilerOverlayVisible && !Profiler::isEnabled()) {
+        Profiler::setEnabled(true);
+        overlayEnabledProfiler = true;
+    }
+    else if (!profilerOverlayVisible && overlayEnabledProfiler) {
+        // Leave profiling on if it was switched on from the command line
+        Profiler::setEnabled(false);
+        overlayEnabledProfiler = false;
+    }
+    updateProfilerOverlay();
+}
+
+void GUI::updateProfilerOverlay() {
+    profilerRefreshClock.restart();
+    Profiler::summarize(2000000000, profilerStats);
+
+    // Whole frames first, then every stage and sub-call
+    std::stable_partition(profilerStats.begin(), profilerStats.end(), [](const Profiler::Stats& stats) {
+        return std::strcmp(stats.name, "frame") == 0;
+    });
+
+    std::string text = "Profiler, last 2 s (ms)        F4: export trace\n";
+    char line[160];
+    for (const Profiler::Stats& stats : profilerStats) {
+        std::snprintf(line, sizeof(line), "%-26s n %-5zu mean %6.2f  p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f\n",
+            stats.name, stats.count, stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+        text += line;
+    }
+    profilerText.setString(text);
+    sf::FloatRect bounds = profilerText.getLocalBounds();
+    profilerBackground.setSize(sf::Vector2f(bounds.width + 20.0f, bounds.height + 20.0f));
+}
 
-        window.draw(songButton);
+GUI::RowText& GUI::getRowText(std::uint32_t track) {
+    auto inserted = rowTexts.try_emplace(track);
+    RowText& text = inserted.first->second;
+    text.lastDrawn = frameNumber;
+    if (!inserted.second) {
+        return text;
+    }
 
-        sf::Text songText;
-        songText.setFont(font);
-        songText.setString(getBaseName(displayFiles[i]));
-        songText.setCharacterSize(30);
-        songText.setFillColor(sf::Color::White);
-        songText.setPosition(320.0f, 60.0f + i * 60.0f + 10.0f);
-        window.draw(songText);
+    text.title = songRowText;
+    text.title.setString(std::string(player.getTracks().getBaseName(track)));
 
-        size_t originalIndex = std::distance(player.getMusicFiles().begin(), it);
-        if (originalIndex == clickedSongIndex && player.getStatus() == sf::SoundSource::Playing) {
-            drawAnimationBars(songButton.getPosition());
+    // Artist and duration come from the metadata cache, so no audio file is opened here
+    if (const TrackMetadata* info = trackMetadata[track]) {
+        sf::String details;
+        if (info->artist[0] != '\0') {
+            details = sf::String::fromUtf8(info->artist, info->artist + std::strlen(info->artist)) + "   ";
         }
+        details += formatTime(static_cast<int>(info->duration));
+        text.details = songRowDetails;
+        text.details.setString(details);
+        text.detailsWidth = text.details.getLocalBounds().width;
     }
+    return text;
 }
 
+void GUI::drawHomePage() {
+    PROFILE_SCOPE("GUI::drawHomePage");
+    songList.setRowCount(displayedTracks.size());
+    currentRowAnimated = false;
+    ++frameNumber;
+
+    // Only the rows inside the viewport are touched; the view clips the partially visible ones
+    window.setView(songListView);
+    for (size_t i = songList.getFirstVisibleRow(); i < songList.getEndVisibleRow(); ++i) {
+        std::uint32_t track = displayedTracks[i];
+        bool isCurrent = static_cast<int>(track) == clickedSongIndex;
+        float rowTop = songList.getRowTop(i);
+
+        songRow.setPosition(300.0f, rowTop);
+        songRow.setFillColor(isCurrent ? sf::Color::Red : sf::Color(70, 70, 70));
+        window.draw(songRow);
+
+        // Laid out once per track; visible rows only move
+        RowText& text = getRowText(track);
+        text.title.setPosition(320.0f, rowTop + 10.0f);
+        window.draw(text.title);
+        if (trackMetadata[track]) {
+            text.details.setPosition(window.getSize().x - 80.0f - text.detailsWidth, rowTop + 14.0f);
+            window.draw(text.details);
+        }
 
+        if (isCurrent && player.getStatus() == sf::SoundSource::Playing) {
+            drawAnimationBars(songRow.getPosition());
+            currentRowAnimated = true;
+        }
+    }
+    window.setView(window.getDefaultView());
+
+    // Keep a few screens' worth of rows; drop the ones that scrolled away long ago
+    size_t visibleRows = songList.getEndVisibleRow() - songList.getFirstVisibleRow();
+    if (rowTexts.size() > std::max<size_t>(256, visibleRows * 4)) {
+        for (auto it = rowTexts.begin(); it != rowTexts.end();) {
+            it = it->second.lastDrawn == frameNumber ? std::next(it) : rowTexts.erase(it);
+        }
+    }
+
+    drawScrollBar();
+}
+
+void GUI::drawScrollBar() {
+    double maxOffset = songList.getMaxScrollOffset();
+    if (maxOffset <= 0.0) {
+        return;
+    }
+    float trackHeight = songList.getViewportHeight();
+    float contentHeight = trackHeight + static_cast<float>(maxOffset);
+    float thumbHeight = std::max(30.0f, trackHeight * trackHeight / contentHeight);
+    float thumbTop = songList.getViewportTop() + static_cast<float>(songList.getScrollOffset() / maxOffset) * (trackHeight - thumbHeight);
+    scrollThumb.setSize(sf::Vector2f(6.0f, thumbHeight));
+    scrollThumb.setPosition(window.getSize().x - 10.0f, thumbTop);
+    window.draw(scrollThumb);
+}
 
 void GUI::drawNowPlayingPage() {
-    sf::Text songNameText;
-    songNameText.setFont(font);
-    std::string wrappedSongName = wrapText(currentSong, 30);
-    songNameText.setString(wrappedSongName);
-    songNameText.setCharacterSize(60);
-    songNameText.setFillColor(sf::Color::White);
-    songNameText.setPosition(contentArea.getPosition().x + (contentArea.getSize().x - songNameText.getLocalBounds().width) / 2,
-        contentArea.getPosition().y + 50.0f);
+    PROFILE_SCOPE("GUI::drawNowPlayingPage");
+    // Wrapping and glyph layout only redo when the song changes
+    if (songNameSource != currentSong) {
+        songNameSource = currentSong;
+        songNameText.setString(wrapText(currentSong, 30));
+        songNameText.setPosition(contentArea.getPosition().x + (contentArea.getSize().x - songNameText.getLocalBounds().width) / 2,
+            contentArea.getPosition().y + 50.0f);
+    }
     window.draw(songNameText);
 
     // Only update the animation time when the song is playing
-    if (player.getStatus() == sf::SoundSource::Playing) {
+    bool isPlaying = player.getStatus() == sf::SoundSource::Playing && !player.isLoading();
+    if (isPlaying) {
         animationTime += clock.restart().asSeconds();
     } else {
         clock.restart(); // Restart the clock but don't update animationTime
@@ -387,88 +733,109 @@ void GUI::drawNowPlayingPage() {
     switch (animationIndex) {
     case 0:
         drawBars();
+        visualizerActive = isPlaying || !barsAnalyzer.isAtRest();
         break;
     case 1:
         drawSpectrum();
+        visualizerActive = isPlaying || !spectrumAnalyzer.isAtRest();
         break;
     case 2:
         drawOscilloscope();
+        visualizerActive = isPlaying;
         break;
     }
 }
 
+void GUI::updateAnalyzer(SpectrumAnalyzer& analyzer) {
+    PROFILE_SCOPE("GUI::updateAnalyzer");
+    float deltaSeconds = analyzerClock.restart().asSeconds();
+    unsigned int sampleRate = 0;
+    if (player.readRecentSamples(recentSamples.data(), recentSamples.size(), sampleRate)) {
+        analyzer.update(recentSamples.data(), sampleRate, deltaSeconds);
+    }
+    else {
+        analyzer.release(deltaSeconds);
+    }
+}
+
 void GUI::drawBars() {
-    const int barCount = 30;
+    PROFILE_SCOPE("GUI::drawBars");
+    updateAnalyzer(barsAnalyzer);
+    const std::vector<float>& levels = barsAnalyzer.getLevels();
+    const size_t barCount = levels.size();
     const float barWidth = 20.0f;
     const float maxBarHeight = 200.0f;
     const float spacing = 5.0f;
     const float startX = contentArea.getPosition().x + (contentArea.getSize().x - (barCount * (barWidth + spacing) - spacing)) / 2;
     const float startY = contentArea.getPosition().y + contentArea.getSize().y / 2 + maxBarHeight / 2;
 
-    for (int i = 0; i < barCount; ++i) {
-        float height = (std::sin(animationTime * 5 + i * 0.5f) + 1) * maxBarHeight / 2;
-        sf::RectangleShape bar(sf::Vector2f(barWidth, height));
-        bar.setFillColor(sf::Color(29, 185, 84));
-        bar.setPosition(startX + i * (barWidth + spacing), startY - height);
-        window.draw(bar);
+    // Two triangles per bar, all bars in one draw call
+    barsGeometry.setPrimitiveType(sf::Triangles);
+    barsGeometry.resize(barCount * 6);
+    for (size_t i = 0; i < barCount; ++i) {
+        float left = startX + i * (barWidth + spacing);
+        float right = left + barWidth;
+        float top = startY - levels[i] * maxBarHeight;
+        sf::Vertex* quad = &barsGeometry[i * 6];
+        quad[0].position = sf::Vector2f(left, top);
+        quad[1].position = sf::Vector2f(right, top);
+        quad[2].position = sf::Vector2f(left, startY);
+        quad[3].position = sf::Vector2f(left, startY);
+        quad[4].position = sf::Vector2f(right, top);
+        quad[5].position = sf::Vector2f(right, startY);
+        for (int corner = 0; corner < 6; ++corner) {
+            quad[corner].color = visualizerColor;
+        }
     }
+    window.draw(barsGeometry);
 }
 
 void GUI::drawSpectrum() {
-    const int pointCount = 1000;
-    sf::VertexArray spectrum(sf::LineStrip, pointCount);
+    PROFILE_SCOPE("GUI::drawSpectrum");
+    updateAnalyzer(spectrumAnalyzer);
+    const std::vector<float>& levels = spectrumAnalyzer.getLevels();
+    const size_t pointCount = levels.size();
     const float width = contentArea.getSize().x;
     const float height = 200.0f;
     const float startX = contentArea.getPosition().x;
     const float startY = contentArea.getPosition().y + contentArea.getSize().y / 2;
 
-    for (int i = 0; i < pointCount; ++i) {
-        float x = startX + (static_cast<float>(i) / pointCount) * width;
-        float y = startY - std::sin(x * 0.05f + animationTime * 5) * height / 2;
-        spectrum[i].position = sf::Vector2f(x, y);
-        spectrum[i].color = sf::Color(29, 185, 84);
+    linePoints.resize(pointCount);
+    for (size_t i = 0; i < pointCount; ++i) {
+        float x = startX + (static_cast<float>(i) / (pointCount - 1)) * width;
+        float y = startY + height / 2 - levels[i] * height;
+        linePoints[i] = sf::Vector2f(x, y);
     }
 
-    // Draw the thick line
-    sf::RectangleShape thickLine;
-    thickLine.setFillColor(sf::Color(29, 185, 84));
-
-    for (int i = 0; i < pointCount - 1; ++i) {
-        sf::Vector2f point1 = spectrum[i].position;
-        sf::Vector2f point2 = spectrum[i + 1].position;
-
-        sf::Vector2f direction = point2 - point1;
-        float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
-
-        thickLine.setSize(sf::Vector2f(length, 5.0f));
-        thickLine.setPosition(point1);
-        thickLine.setRotation(std::atan2(direction.y, direction.x) * 180 / 3.14159f);
-
-        window.draw(thickLine);
-    }
+    buildThickLine(spectrumGeometry, linePoints, 5.0f, visualizerColor);
+    window.draw(spectrumGeometry);
 }
 
 void GUI::drawOscilloscope() {
-    const int pointCount = 1000;
-    const int lineCount = 10;
-    const float lineSpacing = 2.0f;
-    sf::VertexArray oscilloscope(sf::LineStrip, pointCount);
+    PROFILE_SCOPE("GUI::drawOscilloscope");
+    // The waveform is the latest audio itself; silence when nothing plays
+    unsigned int sampleRate = 0;
+    if (!player.readRecentSamples(recentSamples.data(), recentSamples.size(), sampleRate)) {
+        std::fill(recentSamples.begin(), recentSamples.end(), 0.0f);
+    }
+    const size_t pointCount = 1000;
+    const float thickness = 19.0f; // The trace used to be ten 1 px lines, 2 px apart
     const float width = contentArea.getSize().x;
     const float height = 200.0f;
     const float startX = contentArea.getPosition().x;
     const float startY = contentArea.getPosition().y + contentArea.getSize().y / 2;
 
-    for (int line = 0; line < lineCount; ++line) {
-        for (int i = 0; i < pointCount; ++i) {
-            float x = startX + (static_cast<float>(i) / pointCount) * width;
-            float y = startY + std::sin(x * 0.1f + animationTime * 10) * height / 4
-                + std::cos(x * 0.05f + animationTime * 5) * height / 4;
-            y += line * lineSpacing - (lineCount - 1) * lineSpacing / 2;
-            oscilloscope[i].position = sf::Vector2f(x, y);
-            oscilloscope[i].color = sf::Color(29, 185, 84);
-        }
-        window.draw(oscilloscope);
+    // A vertical band around the waveform, one strip for the whole trace
+    oscilloscopeGeometry.setPrimitiveType(sf::TriangleStrip);
+    oscilloscopeGeometry.resize(pointCount * 2);
+    for (size_t i = 0; i < pointCount; ++i) {
+        float x = startX + (static_cast<float>(i) / pointCount) * width;
+        float sample = recentSamples[recentSamples.size() - pointCount + i];
+        float y = startY + sample * height / 2;
+        oscilloscopeGeometry[i * 2] = sf::Vertex(sf::Vector2f(x, y - thickness / 2), visualizerColor);
+        oscilloscopeGeometry[i * 2 + 1] = sf::Vertex(sf::Vector2f(x, y + thickness / 2), visualizerColor);
     }
+    window.draw(oscilloscopeGeometry);
 }
 
 void GUI::drawAnimationBars(const sf::Vector2f& position) {
@@ -481,15 +848,13 @@ void GUI::drawAnimationBars(const sf::Vector2f& position) {
 }
 
 void GUI::drawSearchCursor() {
-    if (cursorBlinkClock.getElapsedTime().asSeconds() < 0.5f) {
+    // update() works out the blink phase, so redraws happen exactly when it flips
+    if (cursorVisible) {
         sf::RectangleShape cursor(sf::Vector2f(2, 20));
         cursor.setFillColor(sf::Color::White);
         cursor.setPosition(15.0f + searchText.getLocalBounds().width, 15.0f);
         window.draw(cursor);
     }
-    if (cursorBlinkClock.getElapsedTime().asSeconds() >= 1.0f) {
-        cursorBlinkClock.restart();
-    }
 }
 
 void GUI::togglePlayPause() {
@@ -550,7 +915,7 @@ void GUI::activateSearchBar() {
 void GUI::deactivateSearchBar() {
     // Check if there was any text in the search bar before setting the placeholder
     if (search.getString().isEmpty()) {
-        search.setString("Search");
+        search.setString(fuzzySearch ? "Fuzzy search" : "Search");
     }
     isSearchBarActive = false;
     searchBar.setFillColor(sf::Color(50, 50, 50));
@@ -567,6 +932,70 @@ void GUI::updateProgressBarPreview(float mouseX) {
     progressFill.setSize(sf::Vector2f(position * progressBar.getSize().x, progressFill.getSize().y));
 }
 
+void GUI::updateWaveform() {
+    size_t track = player.hasStartedPlaying() ? player.getCurrentIndex() : static_cast<size_t>(-1);
+    if (track != waveformTrack) {
+        waveformTrack = track;
+        waveform.reset();
+        seekPreviewVisible = false;
+        invalidate();
+    }
+    if (waveform || track == static_cast<size_t>(-1)) {
+        return;
+    }
+
+    // Asks again every update until the workers have it; usually a few frames for a new track
+    waveform = waveforms.get(track);
+    if (waveform) {
+        waveformColumns.resize(static_cast<size_t>(progressBar.getSize().x));
+        waveform->query(0.0, 1.0, waveformColumns);
+        buildWaveform(waveformGeometry, waveformColumns, progressBar.getGlobalBounds(), unplayedWaveformColor);
+        waveformFillWidth = -1.0f;
+        invalidate();
+    }
+}
+
+void GUI::colorWaveform() {
+    // Played columns take the fill color; only redone when the fill moved
+    float fillWidth = progressFill.getSize().x;
+    if (fillWidth == waveformFillWidth) {
+        return;
+    }
+    waveformFillWidth = fillWidth;
+    float fillEnd = progressBar.getPosition().x + fillWidth;
+    for (size_t i = 0; i < waveformGeometry.getVertexCount(); ++i) {
+        waveformGeometry[i].color = waveformGeometry[i].position.x < fillEnd ? visualizerColor : unplayedWaveformColor;
+    }
+}
+
+void GUI::updateSeekPreview(float mouseX) {
+    float duration = player.getTotalDuration();
+    if (!waveform || duration <= 0) {
+        return;
+    }
+    float position = std::clamp((mouseX - progressBar.getPosition().x) / progressBar.getSize().x, 0.0f, 1.0f);
+    seekPreviewVisible = true;
+
+    // The panel floats above the time labels, centered on the mouse but kept inside the bar's span
+    float left = std::clamp(mouseX - seekPreviewSize.x / 2, progressBar.getPosition().x,
+        progressBar.getPosition().x + progressBar.getSize().x - seekPreviewSize.x);
+    seekPreviewBackground.setPosition(left, progressBar.getPosition().y - seekPreviewSize.y - 45.0f);
+
+    sf::FloatRect area(seekPreviewBackground.getPosition().x + 4, seekPreviewBackground.getPosition().y + 4,
+        seekPreviewSize.x - 8, seekPreviewSize.y - 24);
+    double span = seekPreviewSeconds / duration;
+    waveformColumns.resize(static_cast<size_t>(area.width));
+    waveform->query(position - span, position + span, waveformColumns);
+    buildWaveform(seekPreviewGeometry, waveformColumns, area, visualizerColor);
+    // Marker at the position a click would seek to
+    float center = area.left + area.width / 2;
+    seekPreviewGeometry.append(sf::Vertex(sf::Vector2f(center, area.top), sf::Color::White));
+    seekPreviewGeometry.append(sf::Vertex(sf::Vector2f(center, area.top + area.height), sf::Color::White));
+
+    seekPreviewTime.setString(formatTime(static_cast<int>(position * duration)));
+    seekPreviewTime.setPosition(center - seekPreviewTime.getLocalBounds().width / 2, area.top + area.height + 2);
+}
+
 void GUI::updateVolumeSliderPreview(float mouseX) {
     float volume = (mouseX - volumeSliderBackground.getPosition().x) / volumeSliderBackground.getSize().x;
     volume = std::clamp(volume, 0.0f, 1.0f);
@@ -575,28 +1004,67 @@ void GUI::updateVolumeSliderPreview(float mouseX) {
 }
 
 void GUI::handleHomePageClick(const sf::Event::MouseButtonEvent& mouseButton) {
-    const auto& displayFiles = searchQuery.empty() ? player.getMusicFiles() : filteredMusicFiles;
-    for (size_t i = 0; i < displayFiles.size(); ++i) {
-        sf::RectangleShape songButton(sf::Vector2f(window.getSize().x - 220.0f, 50.0f));
-        songButton.setPosition(300.0f, 60.0f + i * 60.0f);
-
-        if (songButton.getGlobalBounds().contains(mouseButton.x, mouseButton.y)) {
-            // Find the index of the clicked song in the original music files
-            auto it = std::find(player.getMusicFiles().begin(), player.getMusicFiles().end(), displayFiles[i]);
-            if (it != player.getMusicFiles().end()) {
-                size_t originalIndex = std::distance(player.getMusicFiles().begin(), it);
-
-                if (originalIndex != player.getCurrentIndex() || player.getStatus() != sf::SoundSource::Playing) {
-                    player.playSong(originalIndex);
-                    player.play();
-                    playPauseButton.setTexture(pauseTexture);
-                }
-                currentSong = getBaseName(displayFiles[i]);
-                currentPage = Page::NowPlaying;
-                clickedSongIndex = originalIndex;
-                updateTimeDisplay();  // Update the time display immediately
-                break;
-            }
+    size_t row;
+    if (mouseButton.x < 300 || !songList.getRowAt(static_cast<float>(mouseButton.y), row) || row >= displayedTracks.size()) {
+        return;
+    }
+
+    std::uint32_t track = displayedTracks[row];
+    if (track != player.getCurrentIndex() || player.getStatus() != sf::SoundSource::Playing) {
+        player.playSong(track);
+        player.play();
+        playPauseButton.setTexture(pauseTexture);
+    }
+    currentSong = player.getTracks().getBaseName(track);
+    currentPage = Page::NowPlaying;
+    clickedSongIndex = static_cast<int>(track);
+    updateTimeDisplay();  // Update the time display immediately
+}
+
+void GUI::handleKeyPressed(const sf::Event::KeyEvent& key) {
+    if (key.code == sf::Keyboard::F3) {
+        toggleProfilerOverlay();
+        return;
+    }
+    if (key.code == sf::Keyboard::F4) {
+        const std::string tracePath = "../Cache/trace.json";
+        if (Profiler::exportChromeTrace(tracePath)) {
+            std::cout << "Wrote profiler trace to " << tracePath << std::endl;
         }
+        return;
+    }
+    if (currentPage != Page::Home) {
+        return;
     }
-}
\ No newline at end of file
+    switch (key.code) {
+    case sf::Keyboard::PageUp:
+        songList.page(-1);
+        break;
+    case sf::Keyboard::PageDown:
+        songList.page(1);
+        break;
+    case sf::Keyboard::Home:
+        songList.scrollToTop();
+        break;
+    case sf::Keyboard::End:
+        songList.scrollToBottom();
+        break;
+    case sf::Keyboard::Up:
+        songList.scrollBy(-songList.getRowPitch());
+        break;
+    case sf::Keyboard::Down:
+        songList.scrollBy(songList.getRowPitch());
+        break;
+    case sf::Keyboard::Tab:
+        toggleFuzzySearch();
+        break;
+    default:
+        break;
+    }
+}
+
+void GUI::handleMouseWheel(const sf::Event::MouseWheelScrollEvent& wheel) {
+    if (currentPage == Page::Home && wheel.wheel == sf::Mouse::VerticalWheel) {
+        songList.scrollBy(-wheel.delta * 3.0f * songList.getRowPitch());
+    }
+}
@@ -0,0 +1,327 @@
+#include "../header/LibraryScanner.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char indexMagic[8] = { 'M', 'P', 'L', 'I', 'D', 'X', '1', '\0' };
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeString(std::ostream& out, const std::string& value) {
+    writeValue<std::uint32_t>(out, static_cast<std::uint32_t>(value.size()));
+    out.write(value.data(), value.size());
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool readString(std::istream& in, std::string& value) {
+    std::uint32_t length = 0;
+    if (!readValue(in, length)) {
+        return false;
+    }
+    value.resize(length);
+    return static_cast<bool>(in.read(&value[0], length));
+}
+
+std::int64_t toTicks(fs::file_time_type time) {
+    return static_cast<std::int64_t>(time.time_since_epoch().count());
+}
+
+} // namespace
+
+LibraryScanner::LibraryScanner(const std::string& rootDirectory, const std::string& indexPath, unsigned int threadCount)
+    : rootDirectory(rootDirectory), indexPath(indexPath), threadCount(threadCount) {
+    if (this->threadCount == 0) {
+        // Directory listing is I/O bound, so use more threads than cores on small machines
+        this->threadCount = std::max(4u, std::thread::hardware_concurrency());
+    }
+}
+
+bool LibraryScanner::isSupportedExtension(const std::string& extension) {
+    return extension == ".mp3" || extension == ".wav" || extension == ".ogg";
+}
+
+std::vector<LibraryEntry> LibraryScanner::statFiles(const std::vector<std::string>& paths, unsigned int threadCount) {
+    std::vector<LibraryEntry> entries;
+    statInto(paths, entries, nullptr, threadCount);
+    return entries;
+}
+
+std::vector<LibraryEntry> LibraryScanner::statExistingFiles(const std::vector<std::string>& paths, unsigned int threadCount) {
+    std::vector<LibraryEntry> entries;
+    std::vector<char> readable(paths.size(), 0);
+    statInto(paths, entries, &readable, threadCount);
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (readable[i]) {
+            if (kept != i) {
+                entries[kept] = std::move(entries[i]);
+            }
+            ++kept;
+        }
+    }
+    entries.resize(kept);
+    return entries;
+}
+
+void LibraryScanner::statInto(const std::vector<std::string>& paths, std::vector<LibraryEntry>& entries, std::vector<char>* readable,
+    unsigned int threadCount) {
+    entries.assign(paths.size(), LibraryEntry());
+    if (threadCount == 0) {
+        threadCount = std::max(4u, std::thread::hardware_concurrency());
+    }
+    // Workers take blocks of files, so a slow directory does not hold the others up
+    const size_t blockSize = 256;
+    std::atomic<size_t> nextBlock{ 0 };
+    auto worker = [&]() {
+        for (size_t begin; (begin = nextBlock.fetch_add(blockSize)) < paths.size();) {
+            for (size_t i = begin; i < std::min(begin + blockSize, paths.size()); ++i) {
+                std::error_code ec;
+                entries[i].path = paths[i];
+                std::uint64_t size = fs::file_size(paths[i], ec);
+                entries[i].size = ec ? 0 : size;
+                bool ok = !ec;
+                auto time = fs::last_write_time(paths[i], ec);
+                entries[i].mtime = ec ? 0 : toTicks(time);
+                if (readable) {
+                    (*readable)[i] = ok && !ec;
+                }
+            }
+        }
+    };
+
+    size_t blocks = (paths.size() + blockSize - 1) / blockSize;
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min<size_t>(threadCount, blocks); ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+std::vector<LibraryEntry> LibraryScanner::scan() {
+    directoriesListed = 0;
+    directoriesReused = 0;
+    loadIndex();
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::deque<std::string> pending = { rootDirectory };
+    size_t activeWorkers = 0;
+    std::vector<DirectoryRecord> records;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            workAvailable.wait(lock, [&]() { return !pending.empty() || activeWorkers == 0; });
+            if (pending.empty()) {
+                return; // Nothing queued and nobody left to queue more
+            }
+            std::string path = std::move(pending.front());
+            pending.pop_front();
+            ++activeWorkers;
+            lock.unlock();
+
+            DirectoryRecord record;
+            bool reused = false;
+            bool ok = scanDirectory(path, record, reused);
+
+            lock.lock();
+            --activeWorkers;
+            if (ok) {
+                for (const auto& subdirectory : record.subdirectories) {
+                    pending.push_back((fs::path(record.path) / subdirectory).string());
+                }
+                ++(reused ? directoriesReused : directoriesListed);
+                records.push_back(std::move(record));
+            }
+            workAvailable.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    std::sort(records.begin(), records.end(), [](const DirectoryRecord& a, const DirectoryRecord& b) {
+        return a.path < b.path;
+    });
+
+    // Nothing was listed and no directory disappeared, so the index on disk is still exact
+    if (directoriesListed > 0 || records.size() != index.size()) {
+        saveIndex(records);
+    }
+    index.clear();
+
+    std::vector<LibraryEntry> entries;
+    for (const auto& record : records) {
+        for (const auto& file : record.files) {
+            entries.push_back({ (fs::path(record.path) / file.name).string(), file.size, file.mtime });
+        }
+    }
+    return entries;
+}
+
+bool LibraryScanner::scanDirectory(const std::string& path, DirectoryRecord& record, bool& reused) {
+    std::error_code ec;
+    auto directoryTime = fs::last_write_time(path, ec);
+    if (ec) {
+        std::cerr << "Error reading directory: " << path << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+    record.path = path;
+    record.mtime = toTicks(directoryTime);
+
+    // Each directory is visited by exactly one worker, so moving out of its index slot is safe
+    auto cached = index.find(path);
+    if (cached != index.end() && cached->second.mtime == record.mtime) {
+        record.subdirectories = std::move(cached->second.subdirectories);
+        record.files = std::move(cached->second.files);
+        reused = true;
+        return true;
+    }
+
+    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        std::cerr << "Error listing directory: " << path << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            break;
+        }
+        const auto& entry = *it;
+        std::error_code entryError;
+        // Symlinked directories are skipped so a link back up the tree cannot loop forever
+        if (entry.is_directory(entryError) && !entry.is_symlink(entryError)) {
+            record.subdirectories.push_back(entry.path().filename().string());
+        }
+        else if (entry.is_regular_file(entryError) && isSupportedExtension(entry.path().extension().string())) {
+            FileRecord file;
+            file.name = entry.path().filename().string();
+            file.size = entry.file_size(entryError);
+            file.mtime = toTicks(entry.last_write_time(entryError));
+            record.files.push_back(std::move(file));
+        }
+    }
+    std::sort(record.files.begin(), record.files.end(), [](const FileRecord& a, const FileRecord& b) {
+        return a.name < b.name;
+    });
+    return true;
+}
+
+bool LibraryScanner::loadIndex() {
+    index.clear();
+    std::ifstream in(indexPath, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    char magic[sizeof(indexMagic)];
+    std::string root;
+    std::uint32_t directoryCount = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, indexMagic, sizeof(magic)) != 0 ||
+        !readString(in, root) || root != rootDirectory || !readValue(in, directoryCount)) {
+        return false;
+    }
+
+    for (std::uint32_t i = 0; i < directoryCount; ++i) {
+        DirectoryRecord record;
+        std::uint32_t subdirectoryCount = 0;
+        std::uint32_t fileCount = 0;
+        if (!readString(in, record.path) || !readValue(in, record.mtime) || !readValue(in, subdirectoryCount)) {
+            index.clear();
+            return false;
+        }
+        record.subdirectories.resize(subdirectoryCount);
+        for (auto& subdirectory : record.subdirectories) {
+            if (!readString(in, subdirectory)) {
+                index.clear();
+                return false;
+            }
+        }
+        if (!readValue(in, fileCount)) {
+            index.clear();
+            return false;
+        }
+        record.files.resize(fileCount);
+        for (auto& file : record.files) {
+            if (!readString(in, file.name) || !readValue(in, file.size) || !readValue(in, file.mtime)) {
+                index.clear();
+                return false;
+            }
+        }
+        std::string key = record.path;
+        index.emplace(std::move(key), std::move(record));
+    }
+    return true;
+}
+
+bool LibraryScanner::saveIndex(const std::vector<DirectoryRecord>& records) const {
+    std::error_code ec;
+    fs::path target(indexPath);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    // Write to a temporary file first so an interrupted save never leaves a truncated index
+    std::string temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Error writing library index: " << indexPath << std::endl;
+            return false;
+        }
+        out.write(indexMagic, sizeof(indexMagic));
+        writeString(out, rootDirectory);
+        writeValue<std::uint32_t>(out, static_cast<std::uint32_t>(records.size()));
+        for (const auto& record : records) {
+            writeString(out, record.path);
+            writeValue(out, record.mtime);
+            writeValue<std::uint32_t>(out, static_cast<std::uint32_t>(record.subdirectories.size()));
+            for (const auto& subdirectory : record.subdirectories) {
+                writeString(out, subdirectory);
+            }
+            writeValue<std::uint32_t>(out, static_cast<std::uint32_t>(record.files.size()));
+            for (const auto& file : record.files) {
+                writeString(out, file.name);
+                writeValue(out, file.size);
+                writeValue(out, file.mtime);
+            }
+        }
+        if (!out) {
+            std::cerr << "Error writing library index: " << indexPath << std::endl;
+            return false;
+        }
+    }
+    fs::rename(temporaryPath, indexPath, ec);
+    if (ec) {
+        std::cerr << "Error writing library index: " << indexPath << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
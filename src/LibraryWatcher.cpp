@@ -0,0 +1,359 @@
+#include "../header/LibraryWatcher.hpp"
+#include "../header/Profiler.hpp"
+#include "../header/Utilities.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A batch is published once events have stopped for this long...
+const auto quietPeriod = std::chrono::milliseconds(300);
+// ...or this long after its first event, so a long bulk copy shows up while it runs
+const auto maxDelay = std::chrono::seconds(1);
+
+bool isTrack(const std::string& name) {
+    return LibraryScanner::isSupportedExtension(fs::path(name).extension().string());
+}
+
+bool isInside(const std::string& path, const std::string& prefix) {
+    return path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Compares without putting the stored path together
+bool hasPath(const TrackStore& tracks, size_t id, const std::string& path) {
+    std::string_view directory = tracks.getDirectory(id);
+    std::string_view name = tracks.getFileName(id);
+    return path.size() == directory.size() + name.size() && path.compare(0, directory.size(), directory) == 0
+        && path.compare(directory.size(), name.size(), name) == 0;
+}
+
+} // namespace
+
+LibraryWatcher::LibraryWatcher(const std::string& rootDirectory, const TrackStore& tracks)
+    : rootDirectory(rootDirectory), paths(&tracks) {}
+
+LibraryWatcher::~LibraryWatcher() {
+    stop();
+}
+
+bool LibraryWatcher::takeChanges(LibraryChanges& changes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.empty()) {
+        return false;
+    }
+    changes = std::move(ready);
+    ready = LibraryChanges();
+    changesReady = false;
+    return true;
+}
+
+#ifdef __linux__
+
+namespace {
+
+// Files count once written and closed; IN_CREATE is only needed for new directories
+const std::uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR;
+
+} // namespace
+
+bool LibraryWatcher::start() {
+    if (watching) {
+        return true;
+    }
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd == -1 || pipe(wakeFds) == -1) {
+        std::cerr << "Cannot watch the library for changes: " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+    watching = true;
+    thread = std::thread(&LibraryWatcher::run, this);
+    return true;
+}
+
+void LibraryWatcher::stop() {
+    if (thread.joinable()) {
+        char byte = 0;
+        if (write(wakeFds[1], &byte, 1) == -1) {
+            std::cerr << "Error waking the library watcher: " << std::strerror(errno) << std::endl;
+        }
+        thread.join();
+    }
+    for (int* fd : { &inotifyFd, &wakeFds[0], &wakeFds[1] }) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    watching = false;
+}
+
+size_t LibraryWatcher::findKnown(const std::string& path) const {
+    auto found = known.find(hashPath(path));
+    if (found != known.end() && hasPath(paths, found->second, path)) {
+        return found->second;
+    }
+    auto colliding = collisions.find(path);
+    return colliding == collisions.end() ? std::string::npos : colliding->second;
+}
+
+void LibraryWatcher::addKnown(const std::string& path, size_t id) {
+    if (!known.emplace(hashPath(path), id).second) {
+        collisions.emplace(path, id);
+    }
+}
+
+void LibraryWatcher::eraseKnown(const std::string& path, size_t id) {
+    auto found = known.find(hashPath(path));
+    if (found != known.end() && found->second == id) {
+        known.erase(found);
+    }
+    else {
+        collisions.erase(path);
+    }
+}
+
+template <typename Function>
+void LibraryWatcher::forEachKnown(Function function) const {
+    for (const auto& track : known) {
+        function(track.second);
+    }
+    for (const auto& track : collisions) {
+        function(track.second);
+    }
+}
+
+void LibraryWatcher::run() {
+    known.reserve(paths.size());
+    std::string path;
+    for (size_t id = 0; id < paths.size(); ++id) {
+        paths.getPath(id, path);
+        addKnown(path, id);
+    }
+    // Sets up the watches and catches whatever changed since the library was scanned
+    resync();
+    collecting = !pending.empty();
+
+    while (true) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            auto deadline = std::min(lastEvent + quietPeriod, firstPending + maxDelay);
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            timeout = static_cast<int>(std::max<long long>(0, wait));
+        }
+        pollfd descriptors[2] = { { inotifyFd, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } };
+        if (poll(descriptors, 2, timeout) == -1 && errno != EINTR) {
+            std::cerr << "Error watching the library: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (descriptors[1].revents) {
+            return;
+        }
+        if (descriptors[0].revents & POLLIN) {
+            readEvents();
+        }
+        if (overflowed) {
+            overflowed = false;
+            resync();
+        }
+        auto now = Clock::now();
+        if (!pending.empty() && (now - lastEvent >= quietPeriod || now - firstPending >= maxDelay)) {
+            publish();
+        }
+        collecting = !pending.empty();
+    }
+}
+
+void LibraryWatcher::readEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return; // EAGAIN once the queue is drained
+        }
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflowed = true; // Events were lost; list everything again afterwards
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                directories.erase(event->wd);
+                continue;
+            }
+            auto directory = directories.find(event->wd);
+            if (directory == directories.end() || event->len == 0) {
+                continue;
+            }
+            std::string path = (fs::path(directory->second) / event->name).string();
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watchTree(path, nullptr);
+                }
+                else if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+                    forgetTree(path);
+                }
+            }
+            else if (isTrack(event->name)) {
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    markPending(path, true);
+                }
+                else if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+                    markPending(path, false);
+                }
+            }
+        }
+    }
+}
+
+void LibraryWatcher::markPending(const std::string& path, bool present) {
+    auto now = Clock::now();
+    if (pending.empty()) {
+        firstPending = now;
+    }
+    lastEvent = now;
+    pending[path] = present;
+}
+
+void LibraryWatcher::resync() {
+    PROFILE_SCOPE("LibraryWatcher::resync");
+    std::vector<bool> seen(paths.size(), false);
+    watchTree(rootDirectory, &seen);
+    forEachKnown([&](size_t id) {
+        if (!seen[id]) {
+            markPending(paths.getPath(id), false);
+        }
+    });
+}
+
+void LibraryWatcher::watchTree(const std::string& directory, std::vector<bool>* seen) {
+    // The watch goes on before the listing, so files arriving in between are not missed
+    std::vector<std::string> stack = { directory };
+    while (!stack.empty()) {
+        std::string current = std::move(stack.back());
+        stack.pop_back();
+        int watch = inotify_add_watch(inotifyFd, current.c_str(), watchMask);
+        if (watch == -1) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                continue; // Gone again already; its own event follows
+            }
+            std::cerr << "Cannot watch " << current << ": " << std::strerror(errno)
+                << (errno == ENOSPC ? " (raise fs.inotify.max_user_watches)" : "") << std::endl;
+        }
+        else {
+            directories[watch] = current;
+        }
+
+        std::error_code ec;
+        fs::directory_iterator it(current, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const auto& entry = *it;
+            std::error_code entryError;
+            // Symlinked directories are skipped, as the scanner does
+            if (entry.is_directory(entryError) && !entry.is_symlink(entryError)) {
+                stack.push_back(entry.path().string());
+            }
+            else if (entry.is_regular_file(entryError) && LibraryScanner::isSupportedExtension(entry.path().extension().string())) {
+                std::string path = entry.path().string();
+                size_t id = findKnown(path);
+                if (id == std::string::npos) {
+                    markPending(path, true);
+                }
+                else if (seen) {
+                    (*seen)[id] = true;
+                }
+            }
+        }
+    }
+}
+
+void LibraryWatcher::forgetTree(const std::string& directory) {
+    const std::string prefix = (fs::path(directory) / "").string();
+    for (auto it = directories.begin(); it != directories.end();) {
+        if (it->second == directory || isInside(it->second, prefix)) {
+            inotify_rm_watch(inotifyFd, it->first); // Fails harmlessly if the kernel already dropped it
+            it = directories.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    for (auto& change : pending) {
+        if (isInside(change.first, prefix)) {
+            change.second = false;
+        }
+    }
+    std::string path;
+    forEachKnown([&](size_t id) {
+        paths.getPath(id, path);
+        if (isInside(path, prefix)) {
+            markPending(path, false);
+        }
+    });
+}
+
+void LibraryWatcher::publish() {
+    PROFILE_SCOPE("LibraryWatcher::publish");
+    LibraryChanges batch;
+    std::vector<std::string> addedPaths;
+    for (const auto& change : pending) {
+        size_t id = findKnown(change.first);
+        if (change.second && id == std::string::npos) {
+            addedPaths.push_back(change.first);
+        }
+        else if (!change.second && id != std::string::npos) {
+            batch.removed.push_back(id);
+            eraseKnown(change.first, id);
+        }
+    }
+    pending.clear();
+
+    // New tracks join in path order, like the scanner lists them
+    std::sort(addedPaths.begin(), addedPaths.end());
+    std::sort(batch.removed.begin(), batch.removed.end());
+    batch.firstAddedId = paths.size();
+    for (const auto& path : addedPaths) {
+        addKnown(path, paths.size());
+        paths.add(path);
+    }
+    batch.added = LibraryScanner::statFiles(addedPaths);
+    if (batch.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    changesReady = true;
+    if (ready.empty()) {
+        ready = std::move(batch);
+        return;
+    }
+    // Ids are handed out in publishing order, so the added tracks of both batches are contiguous
+    if (ready.added.empty()) {
+        ready.firstAddedId = batch.firstAddedId;
+    }
+    std::move(batch.added.begin(), batch.added.end(), std::back_inserter(ready.added));
+    ready.removed.insert(ready.removed.end(), batch.removed.begin(), batch.removed.end());
+}
+
+#else
+
+bool LibraryWatcher::start() {
+    std::cerr << "Watching the library for changes needs inotify, which this build does not support." << std::endl;
+    return false;
+}
+
+void LibraryWatcher::stop() {}
+
+#endif
@@ -0,0 +1,98 @@
+#include "../header/ListLayout.hpp"
+#include <algorithm>
+#include <cmath>
+
+ListLayout::ListLayout(float rowPitch, float rowHeight) : rowPitch(rowPitch), rowHeight(rowHeight) {}
+
+void ListLayout::setViewport(float top, float height) {
+    viewportTop = top;
+    viewportHeight = std::max(0.0f, height);
+    scrollOffset = clampOffset(scrollOffset);
+    targetOffset = clampOffset(targetOffset);
+}
+
+void ListLayout::setRowCount(size_t count) {
+    rowCount = count;
+    scrollOffset = clampOffset(scrollOffset);
+    targetOffset = clampOffset(targetOffset);
+}
+
+double ListLayout::getMaxScrollOffset() const {
+    return std::max(0.0, static_cast<double>(rowCount) * rowPitch - viewportHeight);
+}
+
+double ListLayout::clampOffset(double offset) const {
+    return std::clamp(offset, 0.0, getMaxScrollOffset());
+}
+
+void ListLayout::scrollBy(float pixels) {
+    targetOffset = clampOffset(targetOffset + pixels);
+}
+
+void ListLayout::scrollToTop() {
+    targetOffset = 0.0;
+}
+
+void ListLayout::scrollToBottom() {
+    targetOffset = getMaxScrollOffset();
+}
+
+void ListLayout::page(int pages) {
+    // Keep one row of context when paging
+    float pageHeight = std::max(rowPitch, viewportHeight - rowPitch);
+    scrollBy(pages * pageHeight);
+}
+
+void ListLayout::ensureVisible(size_t row) {
+    double top = static_cast<double>(row) * rowPitch;
+    if (top < targetOffset) {
+        targetOffset = clampOffset(top);
+    }
+    else if (top + rowHeight > targetOffset + viewportHeight) {
+        targetOffset = clampOffset(top + rowHeight - viewportHeight);
+    }
+}
+
+bool ListLayout::update(float deltaSeconds) {
+    if (!isAnimating()) {
+        return false;
+    }
+    // Exponential approach: frame-rate independent and settles in about a quarter second
+    double blend = 1.0 - std::exp(-deltaSeconds * 18.0);
+    scrollOffset += (targetOffset - scrollOffset) * blend;
+    if (std::fabs(targetOffset - scrollOffset) < 0.5) {
+        scrollOffset = targetOffset;
+    }
+    return true;
+}
+
+bool ListLayout::isAnimating() const {
+    return scrollOffset != targetOffset;
+}
+
+size_t ListLayout::getFirstVisibleRow() const {
+    return std::min(rowCount, static_cast<size_t>(scrollOffset / rowPitch));
+}
+
+size_t ListLayout::getEndVisibleRow() const {
+    size_t end = static_cast<size_t>(std::ceil((scrollOffset + viewportHeight) / rowPitch));
+    return std::min(rowCount, end);
+}
+
+float ListLayout::getRowTop(size_t row) const {
+    return static_cast<float>(viewportTop + static_cast<double>(row) * rowPitch - scrollOffset);
+}
+
+bool ListLayout::getRowAt(float y, size_t& row) const {
+    if (y < viewportTop || y >= viewportTop + viewportHeight) {
+        return false;
+    }
+    double contentY = y - viewportTop + scrollOffset;
+    size_t candidate = static_cast<size_t>(contentY / rowPitch);
+    // The gap between rows belongs to no row
+    if (candidate >= rowCount || contentY - candidate * rowPitch >= rowHeight) {
+        return false;
+    }
+    row = candidate;
+    return true;
+}
@@ -0,0 +1,240 @@
+#include "../header/LoudnessCache.hpp"
+#include "../header/LoudnessMeter.hpp"
+#include "../header/Profiler.hpp"
+#include "../header/Utilities.hpp"
+#include <SFML/Audio.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char cacheMagic[8] = { 'M', 'P', 'L', 'O', 'U', 'D', '1', '\0' };
+const size_t decodeBlockSamples = 1 << 16;
+
+struct CacheHeader {
+    char magic[8];
+    std::uint32_t recordSize;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(CacheHeader) == 16, "CacheHeader is part of the cache file format");
+
+} // namespace
+
+LoudnessCache::LoudnessCache(const std::string& cachePath, const TrackStore& tracks, const FileStamps& stamps)
+    : cachePath(cachePath), tracks(tracks), stamps(stamps), measurements(tracks.size()), measured(tracks.size(), false) {}
+
+LoudnessCache::~LoudnessCache() {
+    stopping = true;
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+void LoudnessCache::open() {
+    if (opened) {
+        return;
+    }
+    load();
+    std::lock_guard<std::mutex> lock(mutex);
+    log.open(cachePath, std::ios::binary | std::ios::app);
+    if (!log) {
+        std::cerr << "Error opening loudness cache: " << cachePath << std::endl;
+    }
+    opened = true;
+}
+
+void LoudnessCache::start(unsigned int threadCount) {
+    open();
+    if (getMeasuredCount() == tracks.size()) {
+        return;
+    }
+
+    // Every core but one, which is left to playback and drawing
+    if (threadCount == 0) {
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&LoudnessCache::work, this);
+    }
+}
+
+bool LoudnessCache::load() {
+    std::unordered_map<std::uint64_t, size_t> ids;
+    ids.reserve(tracks.size());
+    std::string path;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        tracks.getPath(i, path);
+        ids.emplace(hashPath(path), i);
+    }
+
+    std::ifstream in(cachePath, std::ios::binary);
+    CacheHeader header;
+    bool valid = in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 && header.recordSize == sizeof(LoudnessRecord);
+    size_t recordCount = 0;
+    size_t liveCount = 0;
+    LoudnessRecord record;
+    while (valid && in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        ++recordCount;
+        auto track = ids.find(record.pathHash);
+        // Failures written by older versions are dropped too, so those files are measured again
+        if (track == ids.end() || stamps.sizes[track->second] != record.size || stamps.mtimes[track->second] != record.mtime
+            || std::isnan(record.loudness)) {
+            continue;
+        }
+        // Later records win, though a file is only measured again after it changed
+        if (!measured[track->second]) {
+            ++liveCount;
+        }
+        measurements[track->second] = { record.loudness, record.truePeak };
+        measured[track->second] = true;
+    }
+
+    // A record cut short by an interruption, or mostly outdated records: start a fresh log with what is still valid
+    bool truncated = valid && in.gcount() != 0;
+    if (!valid || truncated || recordCount - liveCount > liveCount) {
+        rewrite();
+    }
+    return valid;
+}
+
+bool LoudnessCache::rewrite() const {
+    std::error_code ec;
+    fs::path target(cachePath);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    std::string temporaryPath = cachePath + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header;
+        std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.recordSize = sizeof(LoudnessRecord);
+        header.reserved = 0;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        LoudnessRecord record;
+        for (size_t i = 0; i < measurements.size(); ++i) {
+            if (measured[i]) {
+                initializeRecord(i, record);
+                record.loudness = measurements[i].loudness;
+                record.truePeak = measurements[i].truePeak;
+                out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            }
+        }
+        if (!out) {
+            std::cerr << "Error writing loudness cache: " << cachePath << std::endl;
+            return false;
+        }
+    }
+    fs::rename(temporaryPath, cachePath, ec);
+    if (ec) {
+        std::cerr << "Error writing loudness cache: " << cachePath << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void LoudnessCache::work() {
+    for (size_t track = nextTrack++; track < tracks.size(); track = nextTrack++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (measured[track]) {
+                continue;
+            }
+        }
+        LoudnessRecord record;
+        bool decoded = measure(track, record);
+        if (stopping) {
+            return; // Possibly cut short; measured again next time
+        }
+        if (!decoded) {
+            // Not recorded, so a file that could not be read yet (still being copied, say) is tried again next start
+            std::cerr << "Error measuring loudness: " << tracks.getPath(track) << std::endl;
+            continue;
+        }
+        append(track, record);
+    }
+}
+
+bool LoudnessCache::needsMeasuring(size_t track) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return opened && track < measured.size() && !measured[track];
+}
+
+void LoudnessCache::store(size_t track, float loudness, float truePeak) {
+    if (track >= tracks.size()) {
+        return;
+    }
+    LoudnessRecord record;
+    initializeRecord(track, record);
+    record.loudness = loudness;
+    record.truePeak = truePeak;
+    append(track, record);
+}
+
+void LoudnessCache::append(size_t track, const LoudnessRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    measurements[track] = { record.loudness, record.truePeak };
+    measured[track] = true;
+    // Flushed per track, so an interrupted analysis loses at most the tracks in progress
+    log.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    log.flush();
+}
+
+void LoudnessCache::initializeRecord(size_t track, LoudnessRecord& record) const {
+    record.pathHash = hashPath(tracks.getPath(track));
+    record.size = stamps.sizes[track];
+    record.mtime = stamps.mtimes[track];
+    record.loudness = std::numeric_limits<float>::quiet_NaN();
+    record.truePeak = 0.0f;
+}
+
+bool LoudnessCache::measure(size_t track, LoudnessRecord& record) const {
+    PROFILE_SCOPE("LoudnessCache::measure");
+    initializeRecord(track, record);
+
+    sf::InputSoundFile file;
+    if (!file.openFromFile(tracks.getPath(track)) || file.getChannelCount() == 0) {
+        return false;
+    }
+    unsigned int channelCount = file.getChannelCount();
+    LoudnessMeter meter(file.getSampleRate(), channelCount);
+    std::vector<sf::Int16> samples(decodeBlockSamples / channelCount * channelCount);
+    sf::Uint64 count;
+    while ((count = file.read(samples.data(), samples.size())) > 0) {
+        if (stopping) {
+            return false;
+        }
+        meter.addFrames(samples.data(), static_cast<size_t>(count) / channelCount);
+    }
+    record.loudness = static_cast<float>(meter.getIntegratedLoudness());
+    record.truePeak = static_cast<float>(meter.getTruePeak());
+    return true;
+}
+
+float LoudnessCache::getGain(size_t track) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (track >= measurements.size() || !measured[track] || !std::isfinite(measurements[track].loudness)) {
+        return 1.0f;
+    }
+    const Measurement& measurement = measurements[track];
+    float gain = std::pow(10.0f, (targetLoudness - measurement.loudness) / 20.0f);
+    if (gain > 1.0f && measurement.truePeak > 0.0f) {
+        // Quiet tracks are only boosted as far as their true peak allows
+        gain = std::max(1.0f, std::min(gain, std::pow(10.0f, peakCeiling / 20.0f) / measurement.truePeak));
+    }
+    return gain;
+}
+
+size_t LoudnessCache::getMeasuredCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<size_t>(std::count(measured.begin(), measured.end(), true));
+}
@@ -0,0 +1,198 @@
+#include "../header/LoudnessMeter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOUDNESS_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const double absoluteGate = -70.0;  // LUFS
+const double relativeGate = -10.0;  // LU below the level of the blocks that pass the absolute gate
+const size_t subBlocksPerBlock = 4; // 400 ms blocks advancing in 100 ms steps
+
+// The 4x oversampling interpolator of BS.1770 Annex 2, as four phases of 12 taps
+const size_t peakTaps = 12;
+const float peakFilter[4][peakTaps] = {
+    { 0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f, 0.1373291015625f,
+      0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f, 0.4650878906250f,
+      0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f, 0.7797851562500f,
+      0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f, 0.9721679687500f,
+      0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f },
+};
+
+double toLoudness(double energy) {
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+double toEnergy(double loudness) {
+    return std::pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+} // namespace
+
+LoudnessMeter::LoudnessMeter(unsigned int sampleRate, unsigned int channelCount)
+    : channelCount(channelCount), laneCount((channelCount + 1) / 2 * 2),
+      filterState(laneCount * 4, 0.0), channelWeights(laneCount, 0.0), laneEnergy(laneCount, 0.0),
+      framesPerSubBlock(std::max(1u, sampleRate / 10)), peakHistory(channelCount * peakTaps * 2, 0.0f) {
+    // K-weighting for this sample rate: a high shelf for the head, then a high pass (BS.1770 / libebur128 derivation)
+    double frequency = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(pi * frequency / sampleRate);
+    double vh = std::pow(10.0, gain / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+        2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+    frequency = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(pi * frequency / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    highPass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+    // Surround channels of a 5.1 layout count 1.41 times, the LFE not at all
+    for (unsigned int channel = 0; channel < channelCount; ++channel) {
+        channelWeights[channel] = 1.0;
+        if (channelCount == 6) {
+            channelWeights[channel] = channel == 3 ? 0.0 : channel >= 4 ? 1.41 : 1.0;
+        }
+    }
+}
+
+void LoudnessMeter::addFrames(const std::int16_t* samples, size_t frameCount) {
+    const float scale = 1.0f / 32768.0f;
+    double* state = filterState.data();
+    double* energy = laneEnergy.data();
+
+    for (size_t frame = 0; frame < frameCount; ++frame, samples += channelCount) {
+        // K-weighting, a pair of channels per step; state holds z1, z2 of the shelf then z1, z2 of the high pass
+        for (size_t lane = 0; lane < laneCount; lane += 2) {
+            double left = samples[lane] * scale;
+            double right = lane + 1 < channelCount ? samples[lane + 1] * scale : 0.0;
+            double* z = state + lane * 4;
+#ifdef LOUDNESS_HAS_SSE2
+            __m128d x = _mm_set_pd(right, left);
+            __m128d z1 = _mm_loadu_pd(z), z2 = _mm_loadu_pd(z + 2);
+            __m128d y = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(shelf.b0), x), z1);
+            z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(shelf.b1), x), _mm_mul_pd(_mm_set1_pd(shelf.a1), y)), z2);
+            z2 = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(shelf.b2), x), _mm_mul_pd(_mm_set1_pd(shelf.a2), y));
+            _mm_storeu_pd(z, z1);
+            _mm_storeu_pd(z + 2, z2);
+
+            x = y;
+            z1 = _mm_loadu_pd(z + 4);
+            z2 = _mm_loadu_pd(z + 6);
+            y = _mm_add_pd(x, z1); // b0 of the high pass is 1
+            z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(highPass.b1), x), _mm_mul_pd(_mm_set1_pd(highPass.a1), y)), z2);
+            z2 = _mm_sub_pd(x, _mm_mul_pd(_mm_set1_pd(highPass.a2), y)); // b2 is 1 too
+            _mm_storeu_pd(z + 4, z1);
+            _mm_storeu_pd(z + 6, z2);
+
+            __m128d sum = _mm_loadu_pd(energy + lane);
+            _mm_storeu_pd(energy + lane, _mm_add_pd(sum, _mm_mul_pd(y, y)));
+#else
+            double input[2] = { left, right };
+            for (size_t i = 0; i < 2; ++i) {
+                double x = input[i];
+                double y = shelf.b0 * x + z[i];
+                z[i] = shelf.b1 * x - shelf.a1 * y + z[2 + i];
+                z[2 + i] = shelf.b2 * x - shelf.a2 * y;
+                x = y;
+                y = x + z[4 + i];
+                z[4 + i] = highPass.b1 * x - highPass.a1 * y + z[6 + i];
+                z[6 + i] = x - highPass.a2 * y;
+                energy[lane + i] += y * y;
+            }
+#endif
+        }
+
+        // True peak: the four interpolated phases of each channel come out of one pass over its history
+        peakPosition = (peakPosition + peakTaps - 1) % peakTaps;
+        for (unsigned int channel = 0; channel < channelCount; ++channel) {
+            float* history = peakHistory.data() + channel * peakTaps * 2;
+            float x = samples[channel] * scale;
+            history[peakPosition] = x;
+            history[peakPosition + peakTaps] = x;
+            const float* window = history + peakPosition; // window[k] is the sample k frames ago
+#ifdef LOUDNESS_HAS_SSE2
+            __m128 sum = _mm_setzero_ps();
+            for (size_t k = 0; k < peakTaps; ++k) {
+                __m128 taps = _mm_set_ps(peakFilter[3][k], peakFilter[2][k], peakFilter[1][k], peakFilter[0][k]);
+                sum = _mm_add_ps(sum, _mm_mul_ps(taps, _mm_set1_ps(window[k])));
+            }
+            float phases[4];
+            _mm_storeu_ps(phases, sum);
+#else
+            float phases[4] = {};
+            for (size_t k = 0; k < peakTaps; ++k) {
+                for (size_t phase = 0; phase < 4; ++phase) {
+                    phases[phase] += peakFilter[phase][k] * window[k];
+                }
+            }
+#endif
+            float peak = std::max(std::max(std::fabs(phases[0]), std::fabs(phases[1])), std::max(std::fabs(phases[2]), std::fabs(phases[3])));
+            truePeak = std::max(truePeak, std::max(peak, std::fabs(x)));
+        }
+
+        if (++subBlockFrames == framesPerSubBlock) {
+            double total = 0.0;
+            for (size_t lane = 0; lane < laneCount; ++lane) {
+                total += channelWeights[lane] * laneEnergy[lane];
+                laneEnergy[lane] = 0.0;
+            }
+            subBlocks.push_back(total / framesPerSubBlock);
+            subBlockFrames = 0;
+        }
+    }
+}
+
+double LoudnessMeter::getIntegratedLoudness() const {
+    std::vector<double> blocks;
+    if (subBlocks.size() >= subBlocksPerBlock) {
+        blocks.reserve(subBlocks.size() - subBlocksPerBlock + 1);
+    }
+    for (size_t i = 0; i + subBlocksPerBlock <= subBlocks.size(); ++i) {
+        double energy = 0.0;
+        for (size_t j = 0; j < subBlocksPerBlock; ++j) {
+            energy += subBlocks[i + j];
+        }
+        blocks.push_back(energy / subBlocksPerBlock);
+    }
+
+    // Mean energy of the blocks above threshold, or zero if there are none
+    auto gatedMean = [&](double threshold) {
+        double sum = 0.0;
+        size_t count = 0;
+        for (double energy : blocks) {
+            if (energy > threshold) {
+                sum += energy;
+                ++count;
+            }
+        }
+        return count > 0 ? sum / count : 0.0;
+    };
+
+    double ungated = gatedMean(toEnergy(absoluteGate));
+    if (ungated <= 0.0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    double threshold = std::max(toEnergy(absoluteGate), toEnergy(toLoudness(ungated) + relativeGate));
+    return toLoudness(gatedMean(threshold));
+}
+
+double LoudnessMeter::getTruePeak() const {
+    return truePeak;
+}
+
+double LoudnessMeter::toDecibels(double amplitude) {
+    return amplitude > 0.0 ? 20.0 * std::log10(amplitude) : -std::numeric_limits<double>::infinity();
+}
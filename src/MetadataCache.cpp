@@ -0,0 +1,463 @@
+#include "../header/MetadataCache.hpp"
+#include "../header/Utilities.hpp"
+#include <SFML/Audio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char cacheMagic[8] = { 'M', 'P', 'M', 'E', 'T', 'A', '1', '\0' };
+
+struct CacheHeader {
+    char magic[8];
+    std::uint32_t recordSize;
+    std::uint32_t reserved;
+    std::uint64_t recordCount;
+};
+static_assert(sizeof(CacheHeader) == 24, "CacheHeader is part of the cache file format");
+static_assert(std::is_trivially_copyable<TrackMetadata>::value, "TrackMetadata must be mappable");
+
+// Copies UTF-8 text into a fixed field without cutting a multi-byte sequence in half
+template <size_t N>
+void setField(char (&field)[N], const std::string& value) {
+    size_t length = std::min(value.size(), N - 1);
+    while (length > 0 && length < value.size() && (static_cast<unsigned char>(value[length]) & 0xC0) == 0x80) {
+        --length;
+    }
+    std::memcpy(field, value.data(), length);
+    std::memset(field + length, 0, N - length);
+}
+
+void appendUtf8(std::string& out, std::uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+std::string decodeLatin1(const unsigned char* data, size_t length) {
+    std::string out;
+    for (size_t i = 0; i < length && data[i] != 0; ++i) {
+        appendUtf8(out, data[i]);
+    }
+    return out;
+}
+
+std::string decodeUtf16(const unsigned char* data, size_t length, bool bigEndian) {
+    if (length >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF))) {
+        bigEndian = data[0] == 0xFE;
+        data += 2;
+        length -= 2;
+    }
+    std::string out;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        std::uint32_t unit = bigEndian ? (data[i] << 8 | data[i + 1]) : (data[i + 1] << 8 | data[i]);
+        if (unit == 0) {
+            break;
+        }
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < length) {
+            std::uint32_t low = bigEndian ? (data[i + 2] << 8 | data[i + 3]) : (data[i + 3] << 8 | data[i + 2]);
+            unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+            i += 2;
+        }
+        appendUtf8(out, unit);
+    }
+    return out;
+}
+
+std::string decodeId3Text(const unsigned char* data, size_t length) {
+    if (length == 0) {
+        return std::string();
+    }
+    switch (data[0]) {
+    case 1:
+        return decodeUtf16(data + 1, length - 1, false);
+    case 2:
+        return decodeUtf16(data + 1, length - 1, true);
+    case 3: {
+        std::string text(reinterpret_cast<const char*>(data + 1), length - 1);
+        return text.substr(0, text.find('\0'));
+    }
+    default:
+        return decodeLatin1(data + 1, length - 1);
+    }
+}
+
+std::uint32_t readBigEndian(const unsigned char* data, int bytes) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+std::uint32_t readSyncSafe(const unsigned char* data) {
+    return (data[0] & 0x7F) << 21 | (data[1] & 0x7F) << 14 | (data[2] & 0x7F) << 7 | (data[3] & 0x7F);
+}
+
+std::uint32_t readLittleEndian32(const unsigned char* data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+}
+
+void applyTag(TrackMetadata& metadata, const std::string& key, const std::string& value) {
+    if (value.empty()) {
+        return;
+    }
+    if (key == "TIT2" || key == "TT2" || key == "TITLE") {
+        setField(metadata.title, value);
+    }
+    else if (key == "TPE1" || key == "TP1" || key == "ARTIST") {
+        setField(metadata.artist, value);
+    }
+    else if (key == "TALB" || key == "TAL" || key == "ALBUM") {
+        setField(metadata.album, value);
+    }
+    else if (key == "TRCK" || key == "TRK" || key == "TRACKNUMBER") {
+        metadata.trackNumber = static_cast<std::uint32_t>(std::atoi(value.c_str()));
+    }
+    else if (key == "TYER" || key == "TYE" || key == "TDRC" || key == "DATE") {
+        metadata.year = static_cast<std::uint16_t>(std::atoi(value.c_str()));
+    }
+}
+
+bool readId3v2(std::ifstream& in, TrackMetadata& metadata) {
+    unsigned char header[10];
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || std::memcmp(header, "ID3", 3) != 0) {
+        return false;
+    }
+    int version = header[3];
+    std::uint32_t tagSize = std::min<std::uint32_t>(readSyncSafe(header + 6), 1 << 20);
+    std::vector<unsigned char> tag(tagSize);
+    in.read(reinterpret_cast<char*>(tag.data()), tagSize);
+    tag.resize(static_cast<size_t>(in.gcount()));
+
+    size_t idLength = version == 2 ? 3 : 4;
+    size_t frameHeaderLength = version == 2 ? 6 : 10;
+    size_t position = 0;
+    if (version > 2 && (header[5] & 0x40) && tag.size() >= 4) {
+        // Skip the extended header
+        position = version == 4 ? readSyncSafe(tag.data()) : readBigEndian(tag.data(), 4) + 4;
+    }
+    while (position + frameHeaderLength <= tag.size() && tag[position] != 0) {
+        const unsigned char* frame = tag.data() + position;
+        std::uint32_t frameSize = version == 2 ? readBigEndian(frame + 3, 3)
+            : version == 4 ? readSyncSafe(frame + 4) : readBigEndian(frame + 4, 4);
+        if (position + frameHeaderLength + frameSize > tag.size()) {
+            break;
+        }
+        std::string id(reinterpret_cast<const char*>(frame), idLength);
+        if (id[0] == 'T') {
+            applyTag(metadata, id, decodeId3Text(frame + frameHeaderLength, frameSize));
+        }
+        position += frameHeaderLength + frameSize;
+    }
+    return true;
+}
+
+bool readId3v1(std::ifstream& in, TrackMetadata& metadata) {
+    unsigned char tag[128];
+    in.clear();
+    in.seekg(-128, std::ios::end);
+    if (!in.read(reinterpret_cast<char*>(tag), sizeof(tag)) || std::memcmp(tag, "TAG", 3) != 0) {
+        return false;
+    }
+    auto field = [&](size_t offset, size_t length) {
+        std::string value = decodeLatin1(tag + offset, length);
+        value.erase(value.find_last_not_of(' ') + 1);
+        return value;
+    };
+    applyTag(metadata, "TITLE", field(3, 30));
+    applyTag(metadata, "ARTIST", field(33, 30));
+    applyTag(metadata, "ALBUM", field(63, 30));
+    applyTag(metadata, "DATE", field(93, 4));
+    return true;
+}
+
+// The Vorbis comment packet normally fits in the first pages; page bodies are
+// concatenated so a packet that crosses a page boundary is still read correctly.
+bool readVorbisComment(std::ifstream& in, TrackMetadata& metadata) {
+    std::vector<unsigned char> packets;
+    in.clear();
+    in.seekg(0);
+    for (int page = 0; page < 16 && packets.size() < (1 << 16); ++page) {
+        unsigned char header[27];
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || std::memcmp(header, "OggS", 4) != 0) {
+            break;
+        }
+        unsigned char segmentTable[255];
+        if (!in.read(reinterpret_cast<char*>(segmentTable), header[26])) {
+            break;
+        }
+        size_t bodySize = 0;
+        for (int i = 0; i < header[26]; ++i) {
+            bodySize += segmentTable[i];
+        }
+        size_t offset = packets.size();
+        packets.resize(offset + bodySize);
+        if (!in.read(reinterpret_cast<char*>(packets.data() + offset), bodySize)) {
+            break;
+        }
+    }
+
+    static const unsigned char signature[] = { 3, 'v', 'o', 'r', 'b', 'i', 's' };
+    auto start = std::search(packets.begin(), packets.end(), std::begin(signature), std::end(signature));
+    if (start == packets.end()) {
+        return false;
+    }
+    size_t position = static_cast<size_t>(start - packets.begin()) + sizeof(signature);
+    auto remaining = [&](size_t bytes) { return position + bytes <= packets.size(); };
+    if (!remaining(4)) {
+        return false;
+    }
+    position += 4 + readLittleEndian32(&packets[position]); // Vendor string
+    if (!remaining(4)) {
+        return false;
+    }
+    std::uint32_t commentCount = readLittleEndian32(&packets[position]);
+    position += 4;
+    for (std::uint32_t i = 0; i < commentCount && remaining(4); ++i) {
+        std::uint32_t length = readLittleEndian32(&packets[position]);
+        position += 4;
+        if (!remaining(length)) {
+            break;
+        }
+        std::string comment(reinterpret_cast<const char*>(&packets[position]), length);
+        position += length;
+        size_t separator = comment.find('=');
+        if (separator != std::string::npos) {
+            std::string key = comment.substr(0, separator);
+            std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::toupper(c); });
+            applyTag(metadata, key, comment.substr(separator + 1));
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool readTrackMetadata(const std::string& path, TrackMetadata& metadata) {
+    sf::InputSoundFile soundFile;
+    if (!soundFile.openFromFile(path)) {
+        return false;
+    }
+    metadata.duration = soundFile.getDuration().asSeconds();
+    metadata.sampleRate = soundFile.getSampleRate();
+    metadata.channelCount = static_cast<std::uint16_t>(soundFile.getChannelCount());
+
+    std::ifstream in(path, std::ios::binary);
+    if (in) {
+        if (!readId3v2(in, metadata) && !readVorbisComment(in, metadata)) {
+            readId3v1(in, metadata);
+        }
+    }
+    return true;
+}
+
+MetadataCache::MetadataCache(const std::string& cachePath) : cachePath(cachePath) {}
+
+MetadataCache::~MetadataCache() {
+    stopping = true;
+    if (updateThread.joinable()) {
+        updateThread.join();
+    }
+}
+
+bool MetadataCache::load() {
+    recordCount = 0;
+    if (!file.open(cachePath)) {
+        return false;
+    }
+    CacheHeader header;
+    if (file.size() < sizeof(header)) {
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    // Divided rather than multiplied, so a corrupt count cannot wrap around and pass
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.recordSize != sizeof(TrackMetadata) ||
+        header.recordCount > (file.size() - sizeof(header)) / sizeof(TrackMetadata)) {
+        file.close();
+        return false;
+    }
+    recordCount = static_cast<size_t>(header.recordCount);
+    return true;
+}
+
+const TrackMetadata* MetadataCache::records() const {
+    return reinterpret_cast<const TrackMetadata*>(file.data() + sizeof(CacheHeader));
+}
+
+const TrackMetadata* MetadataCache::findHash(std::uint64_t pathHash) const {
+    if (recordCount == 0) {
+        return nullptr;
+    }
+    const TrackMetadata* begin = records();
+    const TrackMetadata* end = begin + recordCount;
+    const TrackMetadata* it = std::lower_bound(begin, end, pathHash, [](const TrackMetadata& record, std::uint64_t hash) {
+        return record.pathHash < hash;
+    });
+    return it != end && it->pathHash == pathHash ? it : nullptr;
+}
+
+const TrackMetadata* MetadataCache::find(const std::string& path) const {
+    return findHash(hashPath(path));
+}
+
+size_t MetadataCache::update(const TrackStore& tracks, const FileStamps& stamps, unsigned int threadCount) {
+    std::vector<TrackMetadata> newRecords;
+    size_t openedCount = 0;
+    if (collect(tracks, stamps, threadCount, newRecords, openedCount) && writeTemporary(newRecords)) {
+        replace();
+    }
+    return openedCount;
+}
+
+void MetadataCache::startUpdate(const TrackStore& tracks, const FileStamps& stamps, unsigned int threadCount) {
+    if (updateThread.joinable()) {
+        return;
+    }
+    updateThread = std::thread([this, &tracks, &stamps, threadCount]() {
+        std::vector<TrackMetadata> newRecords;
+        size_t openedCount = 0;
+        updateWritten = collect(tracks, stamps, threadCount, newRecords, openedCount) && writeTemporary(newRecords);
+        updateDone = true;
+    });
+}
+
+bool MetadataCache::takeUpdate() {
+    if (!updateDone) {
+        return false;
+    }
+    updateThread.join();
+    updateDone = false;
+    return updateWritten && replace();
+}
+
+bool MetadataCache::collect(const TrackStore& tracks, const FileStamps& stamps, unsigned int threadCount,
+    std::vector<TrackMetadata>& newRecords, size_t& openedCount) const {
+    newRecords.assign(tracks.size(), TrackMetadata());
+    std::vector<size_t> missing;
+    std::string path;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        tracks.getPath(i, path);
+        std::uint64_t pathHash = hashPath(path);
+        const TrackMetadata* cached = findHash(pathHash);
+        if (cached && cached->size == stamps.sizes[i] && cached->mtime == stamps.mtimes[i]) {
+            newRecords[i] = *cached;
+            continue;
+        }
+        newRecords[i].pathHash = pathHash;
+        newRecords[i].size = stamps.sizes[i];
+        newRecords[i].mtime = stamps.mtimes[i];
+        missing.push_back(i);
+    }
+    openedCount = missing.size();
+
+    if (missing.empty() && recordCount == tracks.size()) {
+        return false;
+    }
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::atomic<size_t> nextMissing(0);
+    std::vector<char> unreadable(newRecords.size(), 0);
+    auto worker = [&]() {
+        std::string path;
+        for (size_t i = nextMissing++; i < missing.size() && !stopping; i = nextMissing++) {
+            size_t index = missing[i];
+            tracks.getPath(index, path);
+            if (!readTrackMetadata(path, newRecords[index])) {
+                std::cerr << "Error reading metadata: " << path << std::endl;
+                unreadable[index] = 1;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount && i < missing.size(); ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (stopping) {
+        return false; // Some files were not read; the next start reads them
+    }
+
+    // Not cached, so a file that could not be read yet (still being copied, say) is read again next start
+    size_t kept = 0;
+    for (size_t i = 0; i < newRecords.size(); ++i) {
+        if (!unreadable[i]) {
+            newRecords[kept++] = newRecords[i];
+        }
+    }
+    newRecords.resize(kept);
+
+    std::sort(newRecords.begin(), newRecords.end(), [](const TrackMetadata& a, const TrackMetadata& b) {
+        return a.pathHash < b.pathHash;
+    });
+    newRecords.erase(std::unique(newRecords.begin(), newRecords.end(), [](const TrackMetadata& a, const TrackMetadata& b) {
+        return a.pathHash == b.pathHash;
+    }), newRecords.end());
+    return true;
+}
+
+bool MetadataCache::writeTemporary(const std::vector<TrackMetadata>& newRecords) const {
+    std::error_code ec;
+    fs::path target(cachePath);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+
+    std::ofstream out(getTemporaryPath(), std::ios::binary | std::ios::trunc);
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.recordSize = sizeof(TrackMetadata);
+    header.reserved = 0;
+    header.recordCount = newRecords.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(newRecords.data()), newRecords.size() * sizeof(TrackMetadata));
+    if (!out) {
+        std::cerr << "Error writing metadata cache: " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MetadataCache::replace() {
+    // The old mapping has to go before the file is replaced (required on Windows)
+    file.close();
+    recordCount = 0;
+    std::error_code ec;
+    fs::rename(getTemporaryPath(), cachePath, ec);
+    if (ec) {
+        std::cerr << "Error writing metadata cache: " << cachePath << " (" << ec.message() << ")" << std::endl;
+    }
+    return load() && !ec;
+}
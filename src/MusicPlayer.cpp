@@ -1,65 +1,188 @@
 #include "../header/MusicPlayer.hpp"
+#include "../header/Profiler.hpp"
 #include <iostream>
-#include <algorithm>  // Include this for std::shuffle
+#include <memory>
+#include <utility>
 
-MusicPlayer::MusicPlayer(const std::vector<std::string>& files)
-    : musicFiles(files), currentIndex(0), isShuffled(false), isLooping(false), rng(std::random_device{}()) {
-    for (size_t i = 0; i < musicFiles.size(); ++i) {
-        shuffledIndices.push_back(i);
-    }
+MusicPlayer::MusicPlayer(TrackStore library)
+    : tracks(std::move(library)), removed(tracks.size(), 0), shuffleOrder(tracks.size()), loader(stream, streamMutex), currentIndex(0), isShuffled(false), isLooping(false) {
     // Do not load or play any music here
+    auto preampStage = std::make_unique<Preamp>();
+    auto equalizerStage = std::make_unique<ParametricEq>();
+    auto limiterStage = std::make_unique<SoftLimiter>();
+    preamp = preampStage.get();
+    equalizer = equalizerStage.get();
+    limiter = limiterStage.get();
+    // No track is open yet, so nothing is calling into the chain
+    stream.getDsp().add(std::move(preampStage));
+    stream.getDsp().add(std::move(equalizerStage));
+    stream.getDsp().add(std::move(limiterStage));
 }
 
 void MusicPlayer::play() {
-    if (music.getStatus() != sf::SoundSource::Playing) {
-        music.play();
+    if (getStatus() != sf::SoundSource::Playing) {
+        pendingPosition = getPlaybackPosition();
+        wantsPlaying = true;
+        loader.play();
         startedPlaying = true;
     }
 }
 
 void MusicPlayer::pause() {
-    music.pause();
+    pendingPosition = getPlaybackPosition();
+    wantsPlaying = false;
+    loader.pause();
 }
 
-void MusicPlayer::next() {
-    if (isShuffled) {
-        auto it = std::find(shuffledIndices.begin(), shuffledIndices.end(), currentIndex);
-        if (it != shuffledIndices.end()) {
-            currentIndex = shuffledIndices[(std::distance(shuffledIndices.begin(), it) + 1) % shuffledIndices.size()];
+size_t MusicPlayer::getFollowingIndex() {
+    // Steps over removed tracks; gives back the current one if nothing else is left
+    size_t index = currentIndex;
+    for (size_t step = 0; step < tracks.size(); ++step) {
+        index = isShuffled ? shuffleOrder.next(index) : (index + 1) % tracks.size();
+        if (!removed[index]) {
+            return index;
         }
     }
-    else {
-        currentIndex = (currentIndex + 1) % musicFiles.size();
-    }
+    return currentIndex;
+}
 
-    if (!music.openFromFile(musicFiles[currentIndex])) {
-        std::cerr << "Error loading music file: " << musicFiles[currentIndex] << std::endl;
+size_t MusicPlayer::getPrecedingIndex() {
+    size_t index = currentIndex;
+    for (size_t step = 0; step < tracks.size(); ++step) {
+        index = isShuffled ? shuffleOrder.previous(index) : (index - 1 + tracks.size()) % tracks.size();
+        if (!removed[index]) {
+            return index;
+        }
     }
-    music.setLoop(isLooping);
-    music.play();
-    
+    return currentIndex;
+}
+
+void MusicPlayer::next() {
+    currentIndex = getFollowingIndex();
+    openCurrent(true, crossfadeSeconds > 0.f);
 }
 
 void MusicPlayer::previous() {
     if (!isLooping) {
-        if (isShuffled) {
-            size_t currentPosition = std::find(shuffledIndices.begin(), shuffledIndices.end(), currentIndex) - shuffledIndices.begin();
-            currentIndex = shuffledIndices[(currentPosition - 1 + shuffledIndices.size()) % shuffledIndices.size()];
+        currentIndex = getPrecedingIndex();
+    }
+
+    openCurrent(true, crossfadeSeconds > 0.f);
+}
+
+void MusicPlayer::openCurrent(bool play, bool crossfade) {
+    // The loader reuses the queued track when it is this song; opening replaces any queued track
+    loader.open(currentIndex, tracks.getPath(currentIndex), play, getTrackGain(currentIndex), crossfade);
+    wantsPlaying = play;
+    pendingPosition = 0.f;
+    knownDuration = 0.f;
+    hasOpenSong = true;
+    hasQueuedIndex = false;
+    queueFollowingSong();
+}
+
+void MusicPlayer::queueFollowingSong() {
+    // A looping song never ends, so there is nothing to splice or fade in after it
+    if (!hasOpenSong || (!isGapless && crossfadeSeconds <= 0.f) || isLooping) {
+        if (hasQueuedIndex) {
+            loader.clearNext();
+            hasQueuedIndex = false;
+        }
+        return;
+    }
+    size_t followingIndex = getFollowingIndex();
+    if (removed[followingIndex]) {
+        // Every other track is gone too; let the current one end
+        if (hasQueuedIndex) {
+            loader.clearNext();
+            hasQueuedIndex = false;
+        }
+        return;
+    }
+    if (hasQueuedIndex && queuedIndex == followingIndex) {
+        return;
+    }
+    loader.queueNext(followingIndex, tracks.getPath(followingIndex), getTrackGain(followingIndex));
+    queuedIndex = followingIndex;
+    hasQueuedIndex = true;
+}
+
+float MusicPlayer::getTrackGain(size_t index) const {
+    return loudness ? loudness->getGain(index) : 1.0f;
+}
+
+void MusicPlayer::setLoudness(const LoudnessCache* loudness) {
+    this->loudness = loudness;
+}
+
+void MusicPlayer::updateLibrary(const LibraryChanges& changes) {
+    if (!changes.added.empty()) {
+        if (changes.firstAddedId != tracks.size()) {
+            std::cerr << "Library changes do not follow on from the loaded library; ignoring them" << std::endl;
+            return;
+        }
+        for (const auto& entry : changes.added) {
+            tracks.add(entry.path);
+        }
+        removed.resize(tracks.size(), 0);
+        shuffleOrder.grow(tracks.size());
+    }
+    for (size_t index : changes.removed) {
+        if (index < removed.size()) {
+            removed[index] = 1;
         }
-        else {
-            currentIndex = (currentIndex - 1 + musicFiles.size()) % musicFiles.size();
+    }
+    // The track queued to follow may be gone, or a new one may now come first
+    queueFollowingSong();
+}
+
+bool MusicPlayer::update() {
+    PROFILE_SCOPE("MusicPlayer::update");
+    size_t splicedIndex;
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        if (!stream.takeTrackChange(splicedIndex)) {
+            return false;
         }
     }
+    currentIndex = splicedIndex;
+    hasQueuedIndex = false; // The queued track has just become the current one
+    queueFollowingSong();
+    return true;
+}
+
+void MusicPlayer::setGapless(bool on) {
+    isGapless = on;
+    queueFollowingSong();
+}
+
+bool MusicPlayer::getIsGapless() const {
+    return isGapless;
+}
 
-    if (!music.openFromFile(musicFiles[currentIndex])) {
-        std::cerr << "Error loading music file: " << musicFiles[currentIndex] << std::endl;
+void MusicPlayer::setCrossfade(float seconds, PlaybackStream::FadeCurve curve) {
+    crossfadeSeconds = std::max(0.f, seconds);
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.setCrossfade(sf::seconds(crossfadeSeconds), curve);
     }
-    music.setLoop(isLooping);
-    music.play();
+    queueFollowingSong();
+}
+
+float MusicPlayer::getCrossfade() const {
+    return crossfadeSeconds;
+}
+
+bool MusicPlayer::isLoading() const {
+    return loader.isBusy();
 }
 
 bool MusicPlayer::isCurrentSongFinished() const {
-    return music.getStatus() == sf::SoundSource::Stopped;
+    if (loader.isBusy()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(streamMutex);
+    return stream.getStatus() == sf::SoundSource::Stopped;
 }
 
 bool MusicPlayer::hasStartedPlaying() const {
@@ -70,7 +193,11 @@ void MusicPlayer::setHasStartedPlaying(bool hasStarted) {
     startedPlaying = hasStarted;
 }
 void MusicPlayer::shufflePlaylist() {
-    std::shuffle(shuffledIndices.begin(), shuffledIndices.end(), rng);
+    // O(1): the new order is drawn a position at a time as playback reaches it
+    shuffleOrder.reshuffle();
+    if (hasOpenSong) {
+        shuffleOrder.playNow(currentIndex); // The shuffled order starts from the song playing now
+    }
 }
 
 void MusicPlayer::shuffle(bool on) {
@@ -78,29 +205,35 @@ void MusicPlayer::shuffle(bool on) {
     if (isShuffled) {
         shufflePlaylist();
     }
+    queueFollowingSong();
 }
 
 void MusicPlayer::loop(bool on) {
     isLooping = on;
-    music.setLoop(isLooping);
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.setLoop(isLooping);
+    }
+    queueFollowingSong();
 }
 
 void MusicPlayer::playSong(size_t index) {
-    if (index < musicFiles.size()) {
+    if (index < tracks.size() && !removed[index]) {
         currentIndex = index;
         if (isShuffled) {
-            shuffledIndices.erase(std::remove(shuffledIndices.begin(), shuffledIndices.end(), index), shuffledIndices.end());
-            shuffledIndices.insert(shuffledIndices.begin(), index);
+            shuffleOrder.playNow(index);
         }
-        if (!music.openFromFile(musicFiles[currentIndex])) {
-            std::cerr << "Error loading music file: " << musicFiles[currentIndex] << std::endl;
-        }
-        music.setLoop(isLooping);
+        openCurrent(false);
     }
 }
 
 sf::SoundSource::Status MusicPlayer::getStatus() const {
-    return music.getStatus();
+    // Report what was asked for until the loader has caught up
+    if (loader.isBusy()) {
+        return wantsPlaying ? sf::SoundSource::Playing : sf::SoundSource::Paused;
+    }
+    std::lock_guard<std::mutex> lock(streamMutex);
+    return stream.getStatus();
 }
 
 size_t MusicPlayer::getCurrentIndex() const {
@@ -116,41 +249,66 @@ bool MusicPlayer::getIsLooping() const {
 }
 
 std::string MusicPlayer::getCurrentSong() const {
-    return musicFiles[currentIndex];
+    return tracks.getPath(currentIndex);
 }
 
 float MusicPlayer::getTotalDuration() const {
-        if (music.getDuration().asSeconds() > 0) {
-            return music.getDuration().asSeconds();
-        }
-        return 0.f;  // Return 0 if no valid duration
+    // The loader holds the stream while it opens a song; answer from what was last read
+    if (loader.isBusy()) {
+        return knownDuration;
     }
+    std::lock_guard<std::mutex> lock(streamMutex);
+    float duration = stream.getTrackDuration().asSeconds();
+    knownDuration = duration > 0 ? duration : 0.f;  // 0 if no valid duration
+    return knownDuration;
+}
 
 float MusicPlayer::getPlaybackPosition() const {
-        if (music.getStatus() == sf::Music::Playing || music.getStatus() == sf::Music::Paused) {
-            return music.getPlayingOffset().asSeconds();
-        }
-        return 0.f;
+    if (loader.isBusy()) {
+        return pendingPosition;
+    }
+    std::lock_guard<std::mutex> lock(streamMutex);
+    if (stream.getStatus() == sf::SoundSource::Playing || stream.getStatus() == sf::SoundSource::Paused) {
+        return stream.getTrackOffset().asSeconds();
     }
+    return 0.f;
+}
 
 float MusicPlayer::getPlaybackPercentage() const {
-        float duration = getTotalDuration();
-        if (duration > 0) {
-            return getPlaybackPosition() / duration;
-        }
-        return 0.f;
+    float duration = getTotalDuration();
+    if (duration > 0) {
+        return getPlaybackPosition() / duration;
     }
+    return 0.f;
+}
 
 void MusicPlayer::setPlaybackPosition(float position) {
-        if (position >= 0 && position <= getTotalDuration()) {
-            music.setPlayingOffset(sf::seconds(position));
-        }
+    // A song still opening has no known duration yet, so it cannot be seeked into
+    if (position >= 0 && position <= getTotalDuration()) {
+        pendingPosition = position;
+        loader.seek(sf::seconds(position));
     }
+}
+
+bool MusicPlayer::readRecentSamples(float* samples, size_t count, unsigned int& sampleRate) const {
+    if (loader.isBusy()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(streamMutex);
+    if (stream.getStatus() != sf::SoundSource::Playing) {
+        return false;
+    }
+    sampleRate = stream.getSampleRate();
+    stream.readRecentSamples(samples, count);
+    return true;
+}
 
 float MusicPlayer::getVolume() const {
-    return music.getVolume();
+    std::lock_guard<std::mutex> lock(streamMutex);
+    return stream.getVolume();
 }
 
 void MusicPlayer::setVolume(float volume) {
-    music.setVolume(volume);
+    std::lock_guard<std::mutex> lock(streamMutex);
+    stream.setVolume(volume);
 }
@@ -0,0 +1,122 @@
+#include "../header/PeakPyramid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// Levels stop once one this small exists; it is coarse enough for any view of a track
+const size_t topLevelPeaks = 64;
+
+std::int8_t quantize(std::int16_t sample) {
+    return static_cast<std::int8_t>(sample >> 8);
+}
+
+} // namespace
+
+std::vector<size_t> PeakPyramid::getLevelOffsets(size_t basePeakCount) {
+    std::vector<size_t> offsets{ 0, basePeakCount };
+    size_t count = basePeakCount;
+    while (count > topLevelPeaks) {
+        count = (count + levelFactor - 1) / levelFactor;
+        offsets.push_back(offsets.back() + count);
+    }
+    return offsets;
+}
+
+void PeakPyramid::append(const std::int16_t* samples, size_t frames, unsigned int channelCount) {
+    frameCount += frames;
+    while (frames > 0) {
+        size_t take = std::min(frames, baseFramesPerPeak - pendingFrames);
+        if (pendingFrames == 0) {
+            pendingMin = std::numeric_limits<std::int16_t>::max();
+            pendingMax = std::numeric_limits<std::int16_t>::min();
+        }
+        const std::int16_t* end = samples + take * channelCount;
+        for (const std::int16_t* sample = samples; sample != end; ++sample) {
+            pendingMin = std::min(pendingMin, *sample);
+            pendingMax = std::max(pendingMax, *sample);
+        }
+        samples = end;
+        frames -= take;
+        pendingFrames += take;
+        if (pendingFrames == baseFramesPerPeak) {
+            peaks.push_back({ quantize(pendingMin), quantize(pendingMax) });
+            pendingFrames = 0;
+        }
+    }
+}
+
+void PeakPyramid::finish() {
+    if (pendingFrames > 0) {
+        peaks.push_back({ quantize(pendingMin), quantize(pendingMax) });
+        pendingFrames = 0;
+    }
+
+    // Each level merges groups of levelFactor peaks from the one below
+    levelOffsets = getLevelOffsets(peaks.size());
+    peaks.resize(levelOffsets.back());
+    for (size_t level = 1; level + 1 < levelOffsets.size(); ++level) {
+        size_t belowBegin = levelOffsets[level - 1];
+        size_t belowEnd = levelOffsets[level];
+        for (size_t i = levelOffsets[level]; i < levelOffsets[level + 1]; ++i) {
+            size_t first = belowBegin + (i - levelOffsets[level]) * levelFactor;
+            size_t last = std::min(first + levelFactor, belowEnd);
+            Peak merged = peaks[first];
+            for (size_t j = first + 1; j < last; ++j) {
+                merged.min = std::min(merged.min, peaks[j].min);
+                merged.max = std::max(merged.max, peaks[j].max);
+            }
+            peaks[i] = merged;
+        }
+    }
+}
+
+bool PeakPyramid::assign(std::uint64_t frames, std::vector<Peak> levels) {
+    std::vector<size_t> offsets = getLevelOffsets(static_cast<size_t>((frames + baseFramesPerPeak - 1) / baseFramesPerPeak));
+    if (levels.size() != offsets.back()) {
+        return false;
+    }
+    frameCount = frames;
+    peaks = std::move(levels);
+    levelOffsets = std::move(offsets);
+    pendingFrames = 0;
+    return true;
+}
+
+void PeakPyramid::query(double begin, double end, std::vector<Peak>& columns) const {
+    std::fill(columns.begin(), columns.end(), Peak());
+    if (getLevelCount() == 0 || levelOffsets[1] == 0 || columns.empty() || end <= begin) {
+        return;
+    }
+
+    // Work in level 0 peaks, then pick the coarsest level that still has a peak for every column
+    double basePeaks = static_cast<double>(frameCount) / baseFramesPerPeak;
+    double first = begin * basePeaks;
+    double step = (end - begin) * basePeaks / columns.size();
+    size_t level = 0;
+    double scale = 1.0;
+    while (level + 1 < getLevelCount() && scale * levelFactor <= step) {
+        ++level;
+        scale *= levelFactor;
+    }
+
+    const Peak* levelPeaks = peaks.data() + levelOffsets[level];
+    double count = static_cast<double>(levelOffsets[level + 1] - levelOffsets[level]);
+    for (size_t column = 0; column < columns.size(); ++column) {
+        double from = (first + column * step) / scale;
+        double to = (first + (column + 1) * step) / scale;
+        if (to <= 0 || from >= count) {
+            continue;
+        }
+        size_t i = static_cast<size_t>(std::max(0.0, std::floor(from)));
+        size_t last = std::max(i + 1, static_cast<size_t>(std::min(count, std::ceil(to))));
+        Peak merged = levelPeaks[i];
+        for (++i; i < last; ++i) {
+            merged.min = std::min(merged.min, levelPeaks[i].min);
+            merged.max = std::max(merged.max, levelPeaks[i].max);
+        }
+        columns[column] = merged;
+    }
+}
@@ -0,0 +1,426 @@
+#include "../header/PlaybackStream.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Size of each buffer handed to OpenAL, and of the part of a queued track decoded up front
+const sf::Time chunkDuration = sf::milliseconds(100);
+
+// Longest start of a track decoded up front for a crossfade; the rest streams from disk as usual
+const sf::Time maxPrerollDuration = sf::seconds(4);
+
+// How quickly a track that leaves mid-fade is ramped to silence; short, but long enough not to click
+const sf::Time releaseDuration = sf::milliseconds(10);
+
+// Frames kept for readRecentSamples; a power of two, about 0.7 s at 48 kHz
+const size_t tapCapacity = 1 << 15;
+
+sf::Uint64 toSamples(sf::Time time, unsigned int sampleRate, unsigned int channelCount) {
+    sf::Int64 microseconds = std::max<sf::Int64>(0, time.asMicroseconds());
+    return static_cast<sf::Uint64>(microseconds) * sampleRate / 1000000 * channelCount;
+}
+
+void applyGain(sf::Int16* samples, size_t count, float gain) {
+    for (size_t i = 0; i < count; ++i) {
+        float scaled = samples[i] * gain;
+        samples[i] = static_cast<sf::Int16>(std::max(-32768.0f, std::min(32767.0f, scaled)));
+    }
+}
+
+// Gains of both tracks at progress (0 to 1) through a fade
+void getFadeGains(PlaybackStream::FadeCurve curve, float progress, float& incoming, float& outgoing) {
+    const float halfPi = 1.57079632679f;
+    switch (curve) {
+    case PlaybackStream::FadeCurve::Linear:
+        incoming = progress;
+        outgoing = 1.0f - progress;
+        break;
+    case PlaybackStream::FadeCurve::EqualPower:
+        incoming = std::sin(progress * halfPi);
+        outgoing = std::cos(progress * halfPi);
+        break;
+    case PlaybackStream::FadeCurve::SCurve:
+        incoming = 0.5f - 0.5f * std::cos(progress * 2.0f * halfPi);
+        outgoing = 1.0f - incoming;
+        break;
+    }
+}
+
+sf::Time toTime(sf::Uint64 samples, unsigned int sampleRate, unsigned int channelCount) {
+    if (sampleRate == 0 || channelCount == 0) {
+        return sf::Time::Zero;
+    }
+    return sf::microseconds(static_cast<sf::Int64>(samples / channelCount * 1000000 / sampleRate));
+}
+
+} // namespace
+
+bool PlaybackStream::Track::open(const std::string& path, size_t trackId, sf::Time prerollDuration) {
+    PROFILE_SCOPE("Track::open");
+    if (!file.openFromFile(path)) {
+        return false;
+    }
+    this->trackId = trackId;
+    sf::Time decoded = std::max(chunkDuration, prerollDuration);
+    preroll.resize(static_cast<size_t>(toSamples(decoded, file.getSampleRate(), file.getChannelCount())));
+    preroll.resize(static_cast<size_t>(file.read(preroll.data(), preroll.size())));
+    prerollPosition = 0;
+    position = 0;
+    return true;
+}
+
+size_t PlaybackStream::Track::read(sf::Int16* samples, size_t count) {
+    size_t fromPreroll = std::min(count, preroll.size() - prerollPosition);
+    std::copy_n(preroll.data() + prerollPosition, fromPreroll, samples);
+    prerollPosition += fromPreroll;
+    size_t filled = fromPreroll;
+    if (fromPreroll < count) {
+        filled += static_cast<size_t>(file.read(samples + fromPreroll, count - fromPreroll));
+    }
+    if (gain != 1.0f) {
+        applyGain(samples, filled, gain);
+    }
+    position += filled;
+    return filled;
+}
+
+void PlaybackStream::Track::rewind() {
+    prerollPosition = 0;
+    position = 0;
+    file.seek(static_cast<sf::Uint64>(preroll.size()));
+}
+
+void PlaybackStream::Track::seek(sf::Time offset) {
+    prerollPosition = preroll.size();
+    position = toSamples(offset, getSampleRate(), getChannelCount());
+    file.seek(offset);
+}
+
+sf::Uint64 PlaybackStream::Track::getRemainingSamples() const {
+    // The sample count comes from the file's header, so this is an estimate for some formats
+    sf::Uint64 count = file.getSampleCount();
+    return count > position ? count - position : 0;
+}
+
+PlaybackStream::PlaybackStream() : tapRing(tapCapacity, 0.0f) {}
+
+PlaybackStream::~PlaybackStream() {
+    // The streaming thread calls back into this class, so it has to finish before the members go away
+    stop();
+}
+
+bool PlaybackStream::openQueued(bool crossfade) {
+    std::unique_ptr<Track> track;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        track = std::move(queued);
+    }
+    if (!track) {
+        return false;
+    }
+    setCurrent(std::move(track), crossfade);
+    return true;
+}
+
+void PlaybackStream::setCurrent(std::unique_ptr<Track> track, bool crossfade) {
+    // Query the stream before taking our lock; SoundStream has locks of its own
+    if (crossfade && getStatus() == Playing) {
+        // Released after the lock
+        std::unique_ptr<Track> dropped;
+        std::unique_ptr<Track> following;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (current && !splicePending && this->crossfade > sf::Time::Zero && canSplice(*track)) {
+            unsigned int channelCount = getChannelCount();
+            sf::Uint64 length = toSamples(this->crossfade, getSampleRate(), channelCount);
+            float leavingGain = 1.0f;
+            if (isFading()) {
+                // Turn the running fade around where it stands: the track that was coming in
+                // fades out from the level it had reached, and the one that was already
+                // leaving is ramped down from its level rather than cut mid-waveform
+                float inGain, outGain;
+                getFadeGains(fadeCurve, static_cast<float>(fadePosition) / static_cast<float>(fadeLength), inGain, outGain);
+                leavingGain = inGain;
+                dropped = std::move(released);
+                released = std::move(outgoing);
+                releaseGain = outgoingGain * outGain;
+                releasePosition = 0;
+                releaseLength = std::max<sf::Uint64>(channelCount, toSamples(releaseDuration, getSampleRate(), channelCount));
+            }
+            else {
+                dropped = std::move(outgoing);
+            }
+            following = std::move(queued); // It was to follow the track now fading out
+            outgoing = std::move(current);
+            outgoingGain = leavingGain;
+            current = std::move(track); // Fades in from silence
+            fadePosition = 0;
+            fadeLength = length;
+            trackStart = decodedPosition; // The new track's clock starts once its first samples are heard
+            return;
+        }
+    }
+
+    stop(); // Joins the streaming thread, so nothing below races with onGetData
+    unsigned int channelCount = track->getChannelCount();
+    unsigned int sampleRate = track->getSampleRate();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = std::move(track);
+        queued.reset();
+        outgoing.reset();
+        released.reset();
+        splicePending = false;
+        fadePosition = 0;
+        fadeLength = 0;
+        releasePosition = 0;
+        releaseLength = 0;
+        decodedPosition = 0;
+        trackStart = 0;
+        resetTap(0);
+        buffer.resize(static_cast<size_t>(toSamples(chunkDuration, sampleRate, channelCount)));
+        fadeBuffer.resize(buffer.size());
+        dsp.prepare(sampleRate, channelCount, buffer.size());
+    }
+    initialize(channelCount, sampleRate);
+}
+
+void PlaybackStream::setCrossfade(sf::Time duration, FadeCurve curve) {
+    std::lock_guard<std::mutex> lock(mutex);
+    crossfade = std::max(sf::Time::Zero, duration);
+    fadeCurve = curve;
+}
+
+sf::Time PlaybackStream::getCrossfade() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return crossfade;
+}
+
+sf::Time PlaybackStream::getPrerollDuration() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::min(crossfade, maxPrerollDuration);
+}
+
+void PlaybackStream::setQueued(std::unique_ptr<Track> track) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.swap(track);
+}
+
+void PlaybackStream::clearNext() {
+    std::unique_ptr<Track> track;
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.swap(track);
+}
+
+bool PlaybackStream::getQueuedTrackId(size_t& trackId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!queued) {
+        return false;
+    }
+    trackId = queued->getTrackId();
+    return true;
+}
+
+bool PlaybackStream::canSplice(const Track& track) const {
+    return track.getChannelCount() == getChannelCount() && track.getSampleRate() == getSampleRate();
+}
+
+bool PlaybackStream::takeTrackChange(size_t& trackId) {
+    // Query the stream before taking our lock; SoundStream has locks of its own
+    sf::Uint64 played = toSamples(getPlayingOffset(), getSampleRate(), getChannelCount());
+    std::unique_ptr<Track> finished;
+    std::unique_ptr<Track> silenced;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isReleasing()) {
+        silenced = std::move(released);
+    }
+    if (!splicePending) {
+        if (!isFading()) {
+            finished = std::move(outgoing); // Faded out completely (or nothing is there)
+        }
+        return false;
+    }
+    if (played < splicePosition) {
+        return false;
+    }
+    trackStart = splicePosition;
+    splicePending = false;
+    if (!isFading()) {
+        finished = std::move(outgoing);
+    }
+    trackId = current->getTrackId();
+    return true;
+}
+
+sf::Time PlaybackStream::getTrackDuration() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Track* audible = splicePending ? outgoing.get() : current.get();
+    return audible ? audible->getDuration() : sf::Time::Zero;
+}
+
+sf::Time PlaybackStream::getTrackOffset() const {
+    sf::Uint64 played = toSamples(getPlayingOffset(), getSampleRate(), getChannelCount());
+    std::lock_guard<std::mutex> lock(mutex);
+    sf::Uint64 start = (splicePending && played >= splicePosition) ? splicePosition : trackStart;
+    return toTime(played > start ? played - start : 0, getSampleRate(), getChannelCount());
+}
+
+void PlaybackStream::setTrackOffset(sf::Time offset) {
+    // onSeek restarts the stream's timeline at the offset, so track time and stream time coincide again
+    setPlayingOffset(offset);
+}
+
+bool PlaybackStream::onGetData(Chunk& data) {
+    PROFILE_SCOPE("PlaybackStream::onGetData");
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!current) {
+        return false;
+    }
+
+    size_t filled = 0;
+    if (crossfade > sf::Time::Zero && !isFading() && !getLoop() && !splicePending && queued && canSplice(*queued)) {
+        sf::Uint64 length = toSamples(crossfade, getSampleRate(), getChannelCount());
+        sf::Uint64 remaining = current->getRemainingSamples();
+        // Nothing is known to remain when the file does not state its length; then it is spliced without a fade
+        if (remaining > 0 && remaining <= length + buffer.size()) {
+            // The fade begins in this buffer: play the current track alone up to its exact sample
+            size_t lead = static_cast<size_t>(remaining > length ? remaining - length : 0);
+            filled = current->read(buffer.data(), lead);
+            if (filled == lead) {
+                splicePosition = decodedPosition + filled;
+                splicePending = true;
+                outgoing = std::move(current);
+                current = std::move(queued);
+                fadePosition = 0;
+                fadeLength = std::min(length, remaining); // Shorter if the next track was queued late
+                outgoingGain = 1.0f;
+            }
+        }
+    }
+
+    if (isFading()) {
+        filled = mixFade(filled);
+    }
+    else {
+        filled += current->read(buffer.data() + filled, buffer.size() - filled);
+        if (filled < buffer.size() && !getLoop() && !splicePending && queued && canSplice(*queued)) {
+            // The current track ends inside this buffer: continue with the queued one at the exact sample
+            splicePosition = decodedPosition + filled;
+            splicePending = true;
+            outgoing = std::move(current);
+            current = std::move(queued);
+            filled += current->read(buffer.data() + filled, buffer.size() - filled);
+        }
+    }
+    if (isReleasing()) {
+        mixRelease(filled);
+    }
+    dsp.process(buffer.data(), filled);
+    tap(buffer.data(), filled);
+    decodedPosition += filled;
+
+    data.samples = buffer.data();
+    data.sampleCount = filled;
+    return filled == buffer.size();
+}
+
+size_t PlaybackStream::mixFade(size_t offset) {
+    PROFILE_SCOPE("PlaybackStream::mixFade");
+    // Both tracks from offset to the end of the buffer; past the end of the fade the incoming one plays alone
+    size_t count = buffer.size() - offset;
+    sf::Int16* mixed = buffer.data() + offset;
+    size_t incoming = current->read(mixed, count);
+    std::fill(mixed + incoming, mixed + count, sf::Int16(0));
+    size_t fading = static_cast<size_t>(std::min<sf::Uint64>(count, fadeLength - fadePosition));
+    size_t fadingOut = outgoing->read(fadeBuffer.data(), fading);
+    std::fill(fadeBuffer.begin() + fadingOut, fadeBuffer.begin() + fading, sf::Int16(0));
+
+    unsigned int channelCount = getChannelCount();
+    const float scale = 1.0f / static_cast<float>(fadeLength);
+    for (size_t i = 0; i < fading; i += channelCount) {
+        float inGain, outGain;
+        getFadeGains(fadeCurve, (fadePosition + i) * scale, inGain, outGain);
+        for (unsigned int channel = 0; channel < channelCount; ++channel) {
+            float sample = mixed[i + channel] * inGain + fadeBuffer[i + channel] * outGain * outgoingGain;
+            mixed[i + channel] = static_cast<sf::Int16>(std::max(-32768.0f, std::min(32767.0f, sample)));
+        }
+    }
+    fadePosition += fading;
+    // Whichever track lasts longer decides where the stream ends
+    return offset + std::max(incoming, fadingOut);
+}
+
+void PlaybackStream::mixRelease(size_t count) {
+    // A fade turned around at the start of this buffer, so the ramp starts at its first sample
+    size_t ramping = static_cast<size_t>(std::min<sf::Uint64>(count, releaseLength - releasePosition));
+    size_t read = released->read(fadeBuffer.data(), ramping);
+    unsigned int channelCount = getChannelCount();
+    const float step = releaseGain / static_cast<float>(releaseLength);
+    for (size_t i = 0; i + channelCount <= read; i += channelCount) {
+        float gain = releaseGain - (releasePosition + i) * step;
+        for (unsigned int channel = 0; channel < channelCount; ++channel) {
+            float sample = buffer[i + channel] + fadeBuffer[i + channel] * gain;
+            buffer[i + channel] = static_cast<sf::Int16>(std::max(-32768.0f, std::min(32767.0f, sample)));
+        }
+    }
+    releasePosition += ramping;
+}
+
+void PlaybackStream::onSeek(sf::Time timeOffset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (splicePending) {
+        // The spliced-in track was decoded but never heard; seeking applies to the one still playing
+        current->rewind();
+        queued = std::move(current);
+        current = std::move(outgoing);
+        splicePending = false;
+    }
+    // A fade in progress is abandoned; takeTrackChange releases the tracks that were leaving
+    fadePosition = 0;
+    fadeLength = 0;
+    releasePosition = 0;
+    releaseLength = 0;
+    if (current) {
+        current->seek(timeOffset);
+    }
+    decodedPosition = toSamples(timeOffset, getSampleRate(), getChannelCount());
+    trackStart = 0;
+    dsp.reset();
+    resetTap(getChannelCount() ? decodedPosition / getChannelCount() : 0);
+}
+
+void PlaybackStream::resetTap(sf::Uint64 position) {
+    tapEnd = position;
+    tapFill = 0;
+}
+
+void PlaybackStream::tap(const sf::Int16* samples, size_t count) {
+    unsigned int channelCount = getChannelCount();
+    if (channelCount == 0) {
+        return;
+    }
+    const float scale = 1.0f / (32768.0f * channelCount);
+    for (size_t i = 0; i + channelCount <= count; i += channelCount) {
+        int sum = 0;
+        for (unsigned int channel = 0; channel < channelCount; ++channel) {
+            sum += samples[i + channel];
+        }
+        tapRing[tapEnd & (tapCapacity - 1)] = sum * scale;
+        ++tapEnd;
+    }
+    tapFill = std::min<sf::Uint64>(tapCapacity, tapFill + count / channelCount);
+}
+
+void PlaybackStream::readRecentSamples(float* samples, size_t count) const {
+    unsigned int channelCount = getChannelCount();
+    sf::Uint64 played = channelCount ? toSamples(getPlayingOffset(), getSampleRate(), channelCount) / channelCount : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    sf::Uint64 oldest = tapEnd - tapFill;
+    for (size_t i = 0; i < count; ++i) {
+        // Frame played - count + i, written without going below zero
+        sf::Uint64 back = count - i;
+        bool valid = played >= back && played - back >= oldest && played - back < tapEnd;
+        samples[i] = valid ? tapRing[(played - back) & (tapCapacity - 1)] : 0.0f;
+    }
+}
@@ -0,0 +1,290 @@
+#include "../header/Playlist.hpp"
+#include "../header/LibraryScanner.hpp"
+#include "../header/MappedFile.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool startsWithNoCase(const char* begin, const char* end, const char* prefix) {
+    for (; *prefix; ++prefix, ++begin) {
+        if (begin == end || std::tolower(static_cast<unsigned char>(*begin)) != *prefix) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isAbsolutePath(const char* begin, const char* end) {
+    if (begin == end) {
+        return false;
+    }
+    if (*begin == '/' || *begin == '\\') {
+        return true;
+    }
+    // Windows drive letter
+    return end - begin >= 2 && std::isalpha(static_cast<unsigned char>(begin[0])) && begin[1] == ':';
+}
+
+// A URL scheme such as "http://": letters (and +.-) followed by "://"
+bool hasScheme(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p != end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '+' || *p == '.' || *p == '-')) {
+        ++p;
+    }
+    return p != begin && end - p >= 3 && std::memcmp(p, "://", 3) == 0;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+enum class EntryResult { Added, NotLocal, Unsupported };
+
+// Resolves one playlist entry and appends it to tracks, unless it is not a local file
+// (a stream URL) or not a format the player supports, as the scanner would skip it
+EntryResult appendEntry(const char* begin, const char* end, const std::string& baseDirectory, std::vector<std::string>& tracks) {
+    bool decode = false;
+    if (startsWithNoCase(begin, end, "file://")) {
+        begin += 7;
+        // Skip the host, normally empty or "localhost"
+        const char* slash = std::find(begin, end, '/');
+        begin = slash;
+        // file:///C:/Music keeps only the drive path
+        if (end - begin >= 3 && std::isalpha(static_cast<unsigned char>(begin[1])) && begin[2] == ':') {
+            ++begin;
+        }
+        decode = true;
+    }
+    else if (hasScheme(begin, end)) {
+        return EntryResult::NotLocal;
+    }
+
+    std::string& track = tracks.emplace_back();
+    bool absolute = isAbsolutePath(begin, end);
+    track.reserve((absolute ? 0 : baseDirectory.size()) + static_cast<size_t>(end - begin));
+    if (!absolute) {
+        track = baseDirectory;
+    }
+    size_t start = track.size();
+    if (decode) {
+        for (const char* p = begin; p != end; ++p) {
+            int high, low;
+            if (*p == '%' && end - p >= 3 && (high = hexValue(p[1])) >= 0 && (low = hexValue(p[2])) >= 0) {
+                track.push_back(static_cast<char>(high * 16 + low));
+                p += 2;
+            }
+            else {
+                track.push_back(*p);
+            }
+        }
+    }
+    else {
+        track.append(begin, end);
+    }
+#ifndef _WIN32
+    // Playlists written on Windows separate directories with backslashes
+    std::replace(track.begin() + start, track.end(), '\\', '/');
+#endif
+    size_t dot = track.find_last_of("./\\");
+    if (dot == std::string::npos || track[dot] != '.' || !LibraryScanner::isSupportedExtension(track.substr(dot))) {
+        tracks.pop_back();
+        return EntryResult::Unsupported;
+    }
+    return EntryResult::Added;
+}
+
+// Calls visit(begin, end) for every line with surrounding whitespace (and the \r of CRLF) removed
+template <typename Visit>
+void forEachLine(const char* data, size_t size, Visit visit) {
+    const char* end = data + size;
+    // UTF-8 byte order mark, common in .m3u8 files
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+    }
+    while (data < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(end - data)));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        const char* first = data;
+        const char* last = lineEnd;
+        while (first < last && std::isspace(static_cast<unsigned char>(*first))) {
+            ++first;
+        }
+        while (last > first && std::isspace(static_cast<unsigned char>(last[-1]))) {
+            --last;
+        }
+        if (first != last) {
+            visit(first, last);
+        }
+        data = lineEnd + 1;
+    }
+}
+
+std::string getDirectory(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+std::string getAbsolutePath(const std::string& path, const std::string& workingDirectory) {
+    fs::path absolute = isAbsolutePath(path.data(), path.data() + path.size()) ? fs::path(path) : fs::path(workingDirectory) / path;
+    return absolute.lexically_normal().generic_string();
+}
+
+} // namespace
+
+Playlist::Format Playlist::getFormat(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot != std::string::npos && startsWithNoCase(path.data() + dot, path.data() + path.size(), ".pls") && path.size() - dot == 4) {
+        return Format::Pls;
+    }
+    return Format::M3u;
+}
+
+bool Playlist::load(const std::string& path, std::vector<std::string>& tracks) {
+    PROFILE_SCOPE("Playlist::load");
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Error reading playlist: " << path << std::endl;
+        return false;
+    }
+    const std::string baseDirectory = getDirectory(path);
+    const size_t firstTrack = tracks.size();
+    size_t notLocal = 0;
+    size_t unsupported = 0;
+    auto count = [&](EntryResult result) {
+        notLocal += result == EntryResult::NotLocal;
+        unsupported += result == EntryResult::Unsupported;
+        return result == EntryResult::Added;
+    };
+
+    if (getFormat(path) == Format::M3u) {
+        forEachLine(file.data(), file.size(), [&](const char* begin, const char* end) {
+            // Comments and extended M3U directives such as #EXTINF
+            if (*begin != '#') {
+                count(appendEntry(begin, end, baseDirectory, tracks));
+            }
+        });
+    }
+    else {
+        // Only the FileN= keys matter; titles and lengths are read from the files themselves
+        std::vector<std::pair<unsigned long, size_t>> numbers;
+        forEachLine(file.data(), file.size(), [&](const char* begin, const char* end) {
+            if (!startsWithNoCase(begin, end, "file")) {
+                return;
+            }
+            const char* p = begin + 4;
+            unsigned long number = 0;
+            while (p != end && std::isdigit(static_cast<unsigned char>(*p))) {
+                number = number * 10 + static_cast<unsigned long>(*p++ - '0');
+            }
+            if (p == begin + 4 || p == end || *p != '=') {
+                return;
+            }
+            size_t index = tracks.size();
+            if (count(appendEntry(p + 1, end, baseDirectory, tracks))) {
+                numbers.emplace_back(number, index);
+            }
+        });
+        // Entries are numbered; they are almost always in order already
+        auto byNumber = [](const std::pair<unsigned long, size_t>& a, const std::pair<unsigned long, size_t>& b) {
+            return a.first < b.first;
+        };
+        if (!std::is_sorted(numbers.begin(), numbers.end(), byNumber)) {
+            std::stable_sort(numbers.begin(), numbers.end(), byNumber);
+            std::vector<std::string> ordered;
+            ordered.reserve(numbers.size());
+            for (const auto& number : numbers) {
+                ordered.push_back(std::move(tracks[number.second]));
+            }
+            std::move(ordered.begin(), ordered.end(), tracks.begin() + static_cast<std::ptrdiff_t>(firstTrack));
+        }
+    }
+
+    if (notLocal > 0) {
+        std::cerr << "Skipped " << notLocal << " playlist entries that are not local files: " << path << std::endl;
+    }
+    if (unsupported > 0) {
+        std::cerr << "Skipped " << unsupported << " playlist entries that are not supported audio files: " << path << std::endl;
+    }
+    return true;
+}
+
+bool Playlist::save(const std::string& path, const std::vector<std::string>& tracks) {
+    PROFILE_SCOPE("Playlist::save");
+    std::error_code ec;
+    fs::path target(path);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
+    }
+    const std::string workingDirectory = fs::current_path(ec).generic_string();
+    std::string baseDirectory = getAbsolutePath(getDirectory(path).empty() ? "." : getDirectory(path), workingDirectory);
+    if (baseDirectory.empty() || baseDirectory.back() != '/') {
+        baseDirectory += '/';
+    }
+    const bool pls = getFormat(path) == Format::Pls;
+
+    // Built in memory and written in one go
+    std::string contents = pls ? "[playlist]\n" : "#EXTM3U\n";
+    contents.reserve(tracks.size() * 64);
+    size_t number = 0;
+    // Tracks share directories, so each directory is normalized once and the
+    // part of it written out (relative or absolute) remembered
+    std::unordered_map<std::string, std::string> writtenDirectories;
+    std::string directory;
+    for (const auto& track : tracks) {
+        size_t slash = track.find_last_of("/\\");
+        size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+        directory.assign(track, 0, nameStart);
+        auto found = writtenDirectories.find(directory);
+        if (found == writtenDirectories.end()) {
+            std::string absolute = getAbsolutePath(directory.empty() ? "." : directory, workingDirectory);
+            if (absolute.empty() || absolute.back() != '/') {
+                absolute += '/';
+            }
+            bool inside = absolute.compare(0, baseDirectory.size(), baseDirectory) == 0;
+            found = writtenDirectories.emplace(directory, absolute.substr(inside ? baseDirectory.size() : 0)).first;
+        }
+        if (pls) {
+            contents += "File";
+            contents += std::to_string(++number);
+            contents += '=';
+        }
+        contents += found->second;
+        contents.append(track, nameStart, std::string::npos);
+        contents += '\n';
+    }
+    if (pls) {
+        contents += "NumberOfEntries=" + std::to_string(tracks.size()) + "\nVersion=2\n";
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!out) {
+            std::cerr << "Error writing playlist: " << path << std::endl;
+            return false;
+        }
+    }
+    fs::rename(temporaryPath, path, ec);
+    if (ec) {
+        std::cerr << "Error writing playlist: " << path << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
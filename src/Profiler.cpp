@@ -0,0 +1,132 @@
+#include "../header/Profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+
+namespace {
+
+const size_t ringCapacity = 1 << 16; // A power of two; minutes of frames with a dozen scopes each
+
+// Each slot is a tiny seqlock: sequence is 0 while a writer fills it and the
+// event's index + 1 once it is complete, so readers can skip torn slots
+struct Slot {
+    std::atomic<std::uint64_t> sequence{ 0 };
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<std::uint32_t> thread{ 0 };
+    std::atomic<std::int64_t> start{ 0 };
+    std::atomic<std::int64_t> duration{ 0 };
+};
+
+Slot ring[ringCapacity];
+std::atomic<std::uint64_t> writeIndex{ 0 };
+std::atomic<std::uint32_t> threadCount{ 0 };
+const auto epoch = std::chrono::steady_clock::now();
+
+std::uint32_t currentThread() {
+    thread_local std::uint32_t id = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    return id;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // namespace
+
+void Profiler::setEnabled(bool on) {
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+std::int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::record(const char* name, std::int64_t start, std::int64_t duration) {
+    std::uint64_t index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = ring[index & (ringCapacity - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.thread.store(currentThread(), std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(duration, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::snapshot(std::vector<Event>& events) {
+    events.clear();
+    std::uint64_t end = writeIndex.load(std::memory_order_acquire);
+    std::uint64_t begin = end > ringCapacity ? end - ringCapacity : 0;
+    events.reserve(static_cast<size_t>(end - begin));
+    for (std::uint64_t index = begin; index < end; ++index) {
+        const Slot& slot = ring[index & (ringCapacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+            continue; // Still being written, or already overwritten by a newer event
+        }
+        Event event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+        event.start = slot.start.load(std::memory_order_relaxed);
+        event.duration = slot.duration.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == index + 1) {
+            events.push_back(event);
+        }
+    }
+}
+
+void Profiler::summarize(std::int64_t windowNanoseconds, std::vector<Stats>& stats) {
+    std::vector<Event> events;
+    snapshot(events);
+    std::int64_t since = now() - windowNanoseconds;
+
+    // Names are string literals, so identical names may still be different pointers; group by text
+    std::map<std::string, std::pair<const char*, std::vector<double>>> durations;
+    for (const Event& event : events) {
+        if (event.start >= since) {
+            auto& group = durations[event.name];
+            group.first = event.name;
+            group.second.push_back(event.duration / 1e6);
+        }
+    }
+
+    stats.clear();
+    for (auto& entry : durations) {
+        std::vector<double>& samples = entry.second.second;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        stats.push_back({ entry.second.first, samples.size(), sum / samples.size(),
+            percentile(samples, 0.50), percentile(samples, 0.95), percentile(samples, 0.99), samples.back() });
+    }
+}
+
+bool Profiler::exportChromeTrace(const std::string& path) {
+    std::vector<Event> events;
+    snapshot(events);
+
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        std::cerr << "Error writing trace: " << path << std::endl;
+        return false;
+    }
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); ++i) {
+        const Event& event = events[i];
+        // Complete events; timestamps are in microseconds
+        std::fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            event.name, event.thread, event.start / 1000.0, event.duration / 1000.0, i + 1 < events.size() ? "," : "");
+    }
+    std::fprintf(out, "]}\n");
+    bool written = std::ferror(out) == 0;
+    if (std::fclose(out) != 0 || !written) {
+        std::cerr << "Error writing trace: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
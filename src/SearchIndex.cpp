@@ -0,0 +1,227 @@
+#include "../header/SearchIndex.hpp"
+#include "../header/Profiler.hpp"
+#include "../header/SubstringMatch.hpp"
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+
+namespace {
+
+char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::string toLowerAscii(const std::string& text) {
+    std::string lowered(text);
+    for (char& c : lowered) {
+        c = toLowerAscii(c);
+    }
+    return lowered;
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(const TrackStore& tracks) {
+    offsets.push_back(0);
+    appendNames(tracks);
+    buildPostings();
+}
+
+void SearchIndex::appendNames(const TrackStore& tracks) {
+    // offsets ends with one past the last name; new names start there
+    offsets.reserve(tracks.size() + 1);
+    for (size_t id = size(); id < tracks.size(); ++id) {
+        size_t start = names.size();
+        names += tracks.getBaseName(id);
+        for (size_t i = start; i < names.size(); ++i) {
+            names[i] = toLowerAscii(names[i]);
+        }
+        characterMasks.push_back(getCharacterMask(std::string_view(names).substr(start)));
+        names += '\0';
+        offsets.push_back(static_cast<std::uint32_t>(names.size()));
+    }
+    removed.resize(size(), 0);
+}
+
+void SearchIndex::buildPostings() {
+    PROFILE_SCOPE("SearchIndex::buildPostings");
+    trigramKeys.clear();
+    postingStarts.clear();
+    postings.clear();
+
+    // Collect (trigram, id) pairs; sorting them groups each trigram's ids in ascending order
+    std::vector<std::uint64_t> pairs;
+    pairs.reserve(names.size());
+    for (std::uint32_t id = 0; id < size(); ++id) {
+        std::uint32_t end = offsets[id + 1] - 1;
+        for (std::uint32_t i = offsets[id]; i + 3 <= end; ++i) {
+            pairs.push_back(static_cast<std::uint64_t>(trigramKey(&names[i])) << 32 | id);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    postings.reserve(pairs.size());
+    for (std::uint64_t pair : pairs) {
+        std::uint32_t key = static_cast<std::uint32_t>(pair >> 32);
+        if (trigramKeys.empty() || trigramKeys.back() != key) {
+            trigramKeys.push_back(key);
+            postingStarts.push_back(static_cast<std::uint32_t>(postings.size()));
+        }
+        postings.push_back(static_cast<std::uint32_t>(pair));
+    }
+    postingStarts.push_back(static_cast<std::uint32_t>(postings.size()));
+    indexedCount = static_cast<std::uint32_t>(size());
+}
+
+void SearchIndex::add(const TrackStore& tracks) {
+    if (tracks.size() <= size()) {
+        return;
+    }
+    appendNames(tracks);
+    history.clear();
+
+    // A few tracks copied in are cheaper to scan than to index; a big import is not
+    if (size() - indexedCount > std::max<size_t>(4096, indexedCount / 4)) {
+        buildPostings();
+    }
+}
+
+void SearchIndex::remove(std::uint32_t id) {
+    if (id < size() && !removed[id]) {
+        removed[id] = 1;
+        ++removedCount;
+        history.clear();
+    }
+}
+
+std::uint32_t SearchIndex::trigramKey(const char* text) {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(text[0])) << 16 |
+        static_cast<std::uint32_t>(static_cast<unsigned char>(text[1])) << 8 |
+        static_cast<unsigned char>(text[2]);
+}
+
+bool SearchIndex::nameContains(std::uint32_t id, const std::string& query) const {
+    std::string_view name(names.data() + offsets[id], offsets[id + 1] - offsets[id] - 1);
+    return name.find(query) != std::string_view::npos;
+}
+
+const std::vector<std::uint32_t>& SearchIndex::search(const std::string& query) {
+    PROFILE_SCOPE("SearchIndex::search");
+    std::string lowered = toLowerAscii(query);
+
+    // Drop remembered queries that are not a prefix of this one (backspace or a new query)
+    while (!history.empty() && lowered.compare(0, history.back().first.size(), history.back().first) != 0) {
+        history.pop_back();
+    }
+    if (!history.empty() && history.back().first == lowered) {
+        return history.back().second;
+    }
+
+    std::vector<std::uint32_t> results;
+    if (lowered.empty()) {
+        results.reserve(size() - removedCount);
+        for (std::uint32_t id = 0; id < size(); ++id) {
+            if (!removed[id]) {
+                results.push_back(id);
+            }
+        }
+        return history.emplace_back(lowered, std::move(results)).second;
+    }
+
+    const std::vector<std::uint32_t>* previous = history.empty() ? nullptr : &history.back().second;
+    // Narrowing re-checks every previous hit, so once the query is long enough for
+    // the trigram index that is only worth it if the previous result set was small
+    if (previous && (lowered.size() < 3 || previous->size() <= size() / 16)) {
+        for (std::uint32_t id : *previous) {
+            if (nameContains(id, lowered)) {
+                results.push_back(id);
+            }
+        }
+    }
+    else {
+        searchFull(lowered, results);
+        if (removedCount > 0) {
+            results.erase(std::remove_if(results.begin(), results.end(), [&](std::uint32_t id) {
+                return removed[id] != 0;
+            }), results.end());
+        }
+    }
+    return history.emplace_back(lowered, std::move(results)).second;
+}
+
+void SearchIndex::searchFuzzy(const std::string& query, size_t limit, std::vector<FuzzyMatch>& matches, unsigned int threadCount) const {
+    searchFuzzy(query, limit, 0, size(), matches, threadCount);
+}
+
+void SearchIndex::searchFuzzy(const std::string& query, size_t limit, size_t begin, size_t end, std::vector<FuzzyMatch>& matches,
+    unsigned int threadCount) const {
+    PROFILE_SCOPE("SearchIndex::searchFuzzy");
+    end = std::min(end, size());
+    if (begin >= end) {
+        matches.clear();
+        return;
+    }
+    // Offsets are absolute positions in names, so the range just starts further in
+    findFuzzyMatches(names.data(), offsets.data() + begin, characterMasks.data() + begin, end - begin,
+        removedCount > 0 ? removed.data() + begin : nullptr, query, limit, matches, threadCount);
+    for (auto& match : matches) {
+        match.id += static_cast<std::uint32_t>(begin);
+    }
+}
+
+void SearchIndex::searchFull(const std::string& query, std::vector<std::uint32_t>& results) const {
+    results.clear();
+    if (query.size() < 3) {
+        scanAll(query, results);
+        return;
+    }
+
+    std::vector<std::pair<const std::uint32_t*, const std::uint32_t*>> lists;
+    for (size_t i = 0; i + 3 <= query.size(); ++i) {
+        std::uint32_t key = trigramKey(&query[i]);
+        auto it = std::lower_bound(trigramKeys.begin(), trigramKeys.end(), key);
+        if (it == trigramKeys.end() || *it != key) {
+            // A trigram no indexed name contains, so only tracks added since can match
+            appendUnindexed(query, results);
+            return;
+        }
+        size_t slot = static_cast<size_t>(it - trigramKeys.begin());
+        lists.emplace_back(postings.data() + postingStarts[slot], postings.data() + postingStarts[slot + 1]);
+    }
+
+    // Intersect starting from the shortest list so the candidate set only shrinks
+    std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) {
+        return a.second - a.first < b.second - b.first;
+    });
+    results.assign(lists[0].first, lists[0].second);
+    std::vector<std::uint32_t> scratch;
+    for (size_t i = 1; i < lists.size() && !results.empty(); ++i) {
+        if (lists[i] == lists[i - 1]) {
+            continue;
+        }
+        scratch.clear();
+        std::set_intersection(results.begin(), results.end(), lists[i].first, lists[i].second, std::back_inserter(scratch));
+        results.swap(scratch);
+    }
+
+    // Sharing every trigram does not mean the trigrams are adjacent, so check the survivors
+    if (query.size() > 3) {
+        results.erase(std::remove_if(results.begin(), results.end(), [&](std::uint32_t id) {
+            return !nameContains(id, query);
+        }), results.end());
+    }
+    appendUnindexed(query, results);
+}
+
+void SearchIndex::appendUnindexed(const std::string& query, std::vector<std::uint32_t>& results) const {
+    for (std::uint32_t id = indexedCount; id < size(); ++id) {
+        if (nameContains(id, query)) {
+            results.push_back(id);
+        }
+    }
+}
+
+void SearchIndex::scanAll(const std::string& query, std::vector<std::uint32_t>& results) const {
+    findMatchingNames(names.data(), offsets.data(), size(), query, results);
+}
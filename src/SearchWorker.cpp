@@ -0,0 +1,161 @@
+#include "../header/SearchWorker.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+
+namespace {
+
+// Names scored per step of a fuzzy search: a few milliseconds on one core, which
+// bounds both the wait for a superseded search to stop and the wait in update()
+const size_t sliceSize = 131072;
+
+// submitTime of searches nobody typed, which are not timed
+const std::int64_t untimed = -1;
+
+} // namespace
+
+SearchWorker::SearchWorker(const TrackStore& tracks, size_t fuzzyLimit) : index(tracks), fuzzyLimit(fuzzyLimit) {
+    thread = std::thread(&SearchWorker::run, this);
+}
+
+SearchWorker::~SearchWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        latestGeneration.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void SearchWorker::submit(const std::string& newQuery, bool newFuzzy) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        query = newQuery;
+        fuzzy = newFuzzy;
+        submitTime = Profiler::now();
+        latestGeneration.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+}
+
+bool SearchWorker::takeResults(std::vector<std::uint32_t>& taken, bool& complete) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Results of a superseded query are never shown
+    if (resultsTaken || resultsGeneration != latestGeneration.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    // The worker overwrites results wholesale, so handing the buffers over is enough
+    taken.swap(results);
+    complete = resultsComplete;
+    resultsTaken = true;
+    return true;
+}
+
+bool SearchWorker::isSearching() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completedGeneration != latestGeneration.load(std::memory_order_relaxed) || !resultsTaken;
+}
+
+void SearchWorker::update(const TrackStore& tracks, const std::vector<size_t>& removed) {
+    {
+        std::lock_guard<std::mutex> indexLock(indexMutex);
+        index.add(tracks);
+        for (size_t id : removed) {
+            index.remove(static_cast<std::uint32_t>(id));
+        }
+        // Still under indexMutex, so the running search sees it is stale before its next step
+        std::lock_guard<std::mutex> lock(mutex);
+        submitTime = untimed;
+        latestGeneration.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+}
+
+void SearchWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] {
+            return stopping || startedGeneration != latestGeneration.load(std::memory_order_relaxed);
+        });
+        if (stopping) {
+            return;
+        }
+        startedGeneration = latestGeneration.load(std::memory_order_relaxed);
+        std::uint64_t generation = startedGeneration;
+        std::string currentQuery = query;
+        bool currentFuzzy = fuzzy;
+        std::int64_t currentSubmitTime = submitTime;
+        lock.unlock();
+        search(generation, currentQuery, currentFuzzy, currentSubmitTime);
+        lock.lock();
+    }
+}
+
+void SearchWorker::search(std::uint64_t generation, const std::string& currentQuery, bool currentFuzzy, std::int64_t currentSubmitTime) {
+    PROFILE_SCOPE("SearchWorker::search");
+    std::vector<std::uint32_t> ids;
+    if (!currentFuzzy || currentQuery.find_first_not_of(' ') == std::string::npos) {
+        {
+            std::lock_guard<std::mutex> indexLock(indexMutex);
+            if (isCancelled(generation)) {
+                return;
+            }
+            ids = index.search(currentQuery);
+        }
+        publish(generation, ids, true, currentSubmitTime);
+        return;
+    }
+
+    std::vector<FuzzyMatch> best;
+    std::vector<FuzzyMatch> slice;
+    size_t begin = 0;
+    size_t count;
+    do {
+        {
+            std::lock_guard<std::mutex> indexLock(indexMutex);
+            if (isCancelled(generation)) {
+                return;
+            }
+            count = index.size();
+            size_t end = std::min(begin + sliceSize, count);
+            index.searchFuzzy(currentQuery, fuzzyLimit, begin, end, slice);
+            begin = end;
+        }
+        bool complete = begin >= count;
+        if (slice.empty() && !complete) {
+            continue;
+        }
+        best.insert(best.end(), slice.begin(), slice.end());
+        rankFuzzyMatches(best, fuzzyLimit);
+        ids.clear();
+        for (const auto& match : best) {
+            ids.push_back(match.id);
+        }
+        publish(generation, ids, complete, currentSubmitTime);
+    } while (begin < count);
+}
+
+void SearchWorker::publish(std::uint64_t generation, std::vector<std::uint32_t>& ids, bool complete, std::int64_t currentSubmitTime) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (isCancelled(generation)) {
+        return;
+    }
+    bool first = resultsGeneration != generation;
+    results.swap(ids);
+    resultsGeneration = generation;
+    resultsComplete = complete;
+    resultsTaken = false;
+    if (complete) {
+        completedGeneration = generation;
+    }
+
+    if (currentSubmitTime != untimed && Profiler::isEnabled()) {
+        std::int64_t now = Profiler::now();
+        if (first) {
+            Profiler::record("search: first result", currentSubmitTime, now - currentSubmitTime);
+        }
+        if (complete) {
+            Profiler::record("search: complete", currentSubmitTime, now - currentSubmitTime);
+        }
+    }
+}
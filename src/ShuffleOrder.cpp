@@ -0,0 +1,70 @@
+#include "../header/ShuffleOrder.hpp"
+#include <utility>
+
+ShuffleOrder::ShuffleOrder(size_t count, std::uint32_t seed) : rng(seed) {
+    reset(count);
+}
+
+void ShuffleOrder::reset(size_t count) {
+    order.resize(count);
+    position.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<std::uint32_t>(i);
+        position[i] = static_cast<std::uint32_t>(i);
+    }
+    drawn = 0;
+}
+
+void ShuffleOrder::grow(size_t count) {
+    for (size_t track = order.size(); track < count; ++track) {
+        order.push_back(static_cast<std::uint32_t>(track));
+        position.push_back(static_cast<std::uint32_t>(track));
+    }
+}
+
+void ShuffleOrder::reshuffle() {
+    // Fisher-Yates works from any starting permutation, so the old order can stay as it is
+    drawn = 0;
+}
+
+void ShuffleOrder::place(size_t track, size_t at) {
+    // Swap track into position at, keeping the reverse map in step
+    size_t from = position[track];
+    std::uint32_t displaced = order[at];
+    order[at] = static_cast<std::uint32_t>(track);
+    order[from] = displaced;
+    position[track] = static_cast<std::uint32_t>(at);
+    position[displaced] = static_cast<std::uint32_t>(from);
+}
+
+void ShuffleOrder::drawThrough(size_t last) {
+    while (drawn <= last) {
+        std::uniform_int_distribution<size_t> pick(drawn, order.size() - 1);
+        place(order[pick(rng)], drawn);
+        ++drawn;
+    }
+}
+
+size_t ShuffleOrder::getTrackAt(size_t at) {
+    drawThrough(at);
+    return order[at];
+}
+
+void ShuffleOrder::playNow(size_t track) {
+    if (position[track] >= drawn) {
+        place(track, drawn);
+        ++drawn;
+    }
+}
+
+size_t ShuffleOrder::next(size_t track) {
+    playNow(track);
+    size_t at = position[track] + 1;
+    return getTrackAt(at < order.size() ? at : 0);
+}
+
+size_t ShuffleOrder::previous(size_t track) {
+    playNow(track);
+    size_t at = position[track];
+    return getTrackAt(at > 0 ? at - 1 : order.size() - 1);
+}
@@ -0,0 +1,71 @@
+#include "../header/SpectrumAnalyzer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Levels are shown on a decibel scale from floorDb (empty) to 0 dB (full-scale sine)
+const float floorDb = -70.0f;
+const float attackSeconds = 0.02f;
+const float decaySeconds = 0.3f;
+
+float approach(float level, float target, float deltaSeconds) {
+    float timeConstant = target > level ? attackSeconds : decaySeconds;
+    return level + (target - level) * (1.0f - std::exp(-deltaSeconds / timeConstant));
+}
+
+} // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(size_t fftSize, size_t bandCount, float minFrequency, float maxFrequency)
+    : fft(fftSize), minFrequency(minFrequency), maxFrequency(maxFrequency), power(fft.getBinCount()),
+      bandFirstBin(bandCount), bandEndBin(bandCount), levels(bandCount, 0.0f) {}
+
+void SpectrumAnalyzer::mapBands(unsigned int sampleRate) {
+    mappedSampleRate = sampleRate;
+    float binWidth = static_cast<float>(sampleRate) / fft.getSize();
+    float top = std::min(maxFrequency, sampleRate / 2.0f);
+    float ratio = std::pow(top / minFrequency, 1.0f / levels.size());
+    size_t lastBin = fft.getBinCount() - 1;
+
+    float lower = minFrequency;
+    for (size_t band = 0; band < levels.size(); ++band) {
+        float upper = lower * ratio;
+        size_t first = std::min(lastBin, static_cast<size_t>(lower / binWidth + 0.5f));
+        size_t end = std::min(lastBin + 1, static_cast<size_t>(upper / binWidth + 0.5f));
+        // Low bands can be narrower than a bin; they still read the bin they fall in
+        bandFirstBin[band] = first;
+        bandEndBin[band] = std::max(end, first + 1);
+        lower = upper;
+    }
+}
+
+void SpectrumAnalyzer::update(const float* samples, unsigned int sampleRate, float deltaSeconds) {
+    if (sampleRate == 0) {
+        release(deltaSeconds);
+        return;
+    }
+    if (sampleRate != mappedSampleRate) {
+        mapBands(sampleRate);
+    }
+
+    fft.powerSpectrum(samples, power.data());
+
+    float reference = fft.getSize() / 4.0f;
+    reference *= reference;
+    for (size_t band = 0; band < levels.size(); ++band) {
+        float peak = *std::max_element(power.begin() + bandFirstBin[band], power.begin() + bandEndBin[band]);
+        float db = 10.0f * std::log10(peak / reference + 1e-12f);
+        float target = std::clamp(1.0f - db / floorDb, 0.0f, 1.0f);
+        levels[band] = approach(levels[band], target, deltaSeconds);
+    }
+}
+
+bool SpectrumAnalyzer::isAtRest() const {
+    return std::all_of(levels.begin(), levels.end(), [](float level) { return level < 0.002f; });
+}
+
+void SpectrumAnalyzer::release(float deltaSeconds) {
+    for (float& level : levels) {
+        level = approach(level, 0.0f, deltaSeconds);
+    }
+}
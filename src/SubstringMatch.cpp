@@ -0,0 +1,199 @@
+#include "../header/SubstringMatch.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATCH_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MATCH_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define MATCH_HAS_AVX2 1
+#define MATCH_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(MATCH_HAS_SSE2) && defined(__AVX2__)
+#define MATCH_HAS_AVX2 1
+#define MATCH_AVX2_TARGET
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+unsigned int countTrailingZeros(std::uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+// Shared bookkeeping for the kernels. Every kernel scans the whole buffer
+// for positions where the first and last query bytes line up, and hands
+// full candidates to accept(), which maps the position back to a name.
+class Matcher {
+public:
+    Matcher(const char* names, const std::uint32_t* offsets, size_t count, const std::string& query, std::vector<std::uint32_t>& matches)
+        : names(names), offsets(offsets), total(offsets[count]), query(query), length(query.size()), matches(matches) {}
+
+    bool verify(size_t position) const {
+        return length <= 2 || std::memcmp(names + position + 1, query.data() + 1, length - 2) == 0;
+    }
+
+    // Records the name containing position and returns where scanning resumes:
+    // the start of the next name, since one hit per name is enough
+    size_t accept(size_t position) {
+        while (offsets[name + 1] <= position) {
+            ++name;
+        }
+        matches.push_back(static_cast<std::uint32_t>(name));
+        return offsets[name + 1];
+    }
+
+    void scanScalar(size_t position) {
+        const char first = query[0];
+        const char last = query[length - 1];
+        while (position + length <= total) {
+            if (names[position] == first && names[position + length - 1] == last && verify(position)) {
+                position = accept(position);
+            }
+            else {
+                ++position;
+            }
+        }
+    }
+
+#ifdef MATCH_HAS_SSE2
+    void scanSSE2() {
+        const __m128i first = _mm_set1_epi8(query[0]);
+        const __m128i last = _mm_set1_epi8(query[length - 1]);
+        size_t position = 0;
+        while (position + length - 1 + 16 <= total) {
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(names + position));
+            __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(names + position + length - 1));
+            std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+            size_t next = position + 16;
+            while (mask != 0) {
+                size_t candidate = position + countTrailingZeros(mask);
+                if (verify(candidate)) {
+                    next = accept(candidate);
+                    break;
+                }
+                mask &= mask - 1;
+            }
+            position = next;
+        }
+        scanScalar(position);
+    }
+#endif
+
+#ifdef MATCH_HAS_AVX2
+    MATCH_AVX2_TARGET void scanAVX2() {
+        const __m256i first = _mm256_set1_epi8(query[0]);
+        const __m256i last = _mm256_set1_epi8(query[length - 1]);
+        size_t position = 0;
+        while (position + length - 1 + 32 <= total) {
+            __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(names + position));
+            __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(names + position + length - 1));
+            std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+            size_t next = position + 32;
+            while (mask != 0) {
+                size_t candidate = position + countTrailingZeros(mask);
+                if (verify(candidate)) {
+                    next = accept(candidate);
+                    break;
+                }
+                mask &= mask - 1;
+            }
+            position = next;
+        }
+        scanScalar(position);
+    }
+#endif
+
+private:
+    const char* names;
+    const std::uint32_t* offsets;
+    size_t total;
+    const std::string& query;
+    size_t length;
+    std::vector<std::uint32_t>& matches;
+    size_t name = 0;
+};
+
+} // namespace
+
+bool isMatchKernelSupported(MatchKernel kernel) {
+    switch (kernel) {
+    case MatchKernel::Scalar:
+        return true;
+    case MatchKernel::SSE2:
+#ifdef MATCH_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case MatchKernel::AVX2:
+#if defined(MATCH_HAS_AVX2) && defined(__AVX2__)
+        return true;
+#elif defined(MATCH_HAS_AVX2)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+void findMatchingNames(MatchKernel kernel, const char* names, const std::uint32_t* offsets, size_t count,
+    const std::string& query, std::vector<std::uint32_t>& matches) {
+    if (query.empty()) {
+        for (size_t id = 0; id < count; ++id) {
+            matches.push_back(static_cast<std::uint32_t>(id));
+        }
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    std::string folded(query);
+    for (char& c : folded) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    Matcher matcher(names, offsets, count, folded, matches);
+
+    if (!isMatchKernelSupported(kernel)) {
+        kernel = MatchKernel::Scalar;
+    }
+    switch (kernel) {
+#ifdef MATCH_HAS_AVX2
+    case MatchKernel::AVX2:
+        matcher.scanAVX2();
+        break;
+#endif
+#ifdef MATCH_HAS_SSE2
+    case MatchKernel::SSE2:
+        matcher.scanSSE2();
+        break;
+#endif
+    default:
+        matcher.scanScalar(0);
+        break;
+    }
+}
+
+void findMatchingNames(const char* names, const std::uint32_t* offsets, size_t count,
+    const std::string& query, std::vector<std::uint32_t>& matches) {
+    static const MatchKernel best = isMatchKernelSupported(MatchKernel::AVX2) ? MatchKernel::AVX2
+        : isMatchKernelSupported(MatchKernel::SSE2) ? MatchKernel::SSE2 : MatchKernel::Scalar;
+    findMatchingNames(best, names, offsets, count, query, matches);
+}
@@ -0,0 +1,212 @@
+#include "../header/TrackLoader.hpp"
+#include "../header/Profiler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+TrackLoader::TrackLoader(PlaybackStream& stream, std::mutex& streamMutex)
+    : stream(stream), streamMutex(streamMutex), thread(&TrackLoader::run, this) {}
+
+TrackLoader::~TrackLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    commandAvailable.notify_one();
+    thread.join();
+}
+
+void TrackLoader::open(size_t trackId, const std::string& path, bool play, float gain, bool crossfade) {
+    Command command{ CommandType::Open };
+    command.trackId = trackId;
+    command.path = path;
+    command.play = play;
+    command.crossfade = crossfade;
+    command.gain = gain;
+    post(std::move(command));
+}
+
+void TrackLoader::queueNext(size_t trackId, const std::string& path, float gain) {
+    Command command{ CommandType::Queue };
+    command.trackId = trackId;
+    command.path = path;
+    command.gain = gain;
+    post(std::move(command));
+}
+
+void TrackLoader::clearNext() {
+    post(Command{ CommandType::ClearQueue });
+}
+
+void TrackLoader::seek(sf::Time offset) {
+    Command command{ CommandType::Seek };
+    command.offset = offset;
+    post(std::move(command));
+}
+
+void TrackLoader::play() {
+    post(Command{ CommandType::Play });
+}
+
+void TrackLoader::pause() {
+    post(Command{ CommandType::Pause });
+}
+
+bool TrackLoader::isBackground(CommandType type) {
+    return type == CommandType::Queue || type == CommandType::ClearQueue;
+}
+
+bool TrackLoader::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running && !isBackground(runningType)) {
+        return true;
+    }
+    return std::any_of(commands.begin(), commands.end(), [](const Command& pending) {
+        return !isBackground(pending.type);
+    });
+}
+
+void TrackLoader::post(Command command) {
+    // Decide which waiting commands the new one makes pointless
+    auto supersedes = [&](CommandType pending) {
+        switch (command.type) {
+        case CommandType::Open:
+            return true; // A new track resets position, queue and play state
+        case CommandType::Queue:
+        case CommandType::ClearQueue:
+            return pending == CommandType::Queue || pending == CommandType::ClearQueue;
+        case CommandType::Seek:
+            return pending == CommandType::Seek;
+        case CommandType::Play:
+        case CommandType::Pause:
+            return pending == CommandType::Play || pending == CommandType::Pause;
+        }
+        return false;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        commands.erase(std::remove_if(commands.begin(), commands.end(), [&](const Command& pending) {
+            return supersedes(pending.type);
+        }), commands.end());
+        commands.push_back(std::move(command));
+    }
+    commandAvailable.notify_one();
+}
+
+bool TrackLoader::isSuperseded(CommandType type) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::any_of(commands.begin(), commands.end(), [&](const Command& pending) {
+        return pending.type == type || pending.type == CommandType::Open;
+    });
+}
+
+void TrackLoader::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        commandAvailable.wait(lock, [this]() { return stopping || !commands.empty(); });
+        if (stopping) {
+            return;
+        }
+        Command command = std::move(commands.front());
+        commands.pop_front();
+        running = true;
+        runningType = command.type;
+        lock.unlock();
+
+        execute(command);
+
+        lock.lock();
+        running = false;
+    }
+}
+
+void TrackLoader::execute(const Command& command) {
+    PROFILE_SCOPE("TrackLoader::execute");
+    // Play, pause and seek requests made after a failed open would act on the previous song
+    if (!hasTrack && command.type != CommandType::Open && !isBackground(command.type)) {
+        return;
+    }
+
+    switch (command.type) {
+    case CommandType::Open: {
+        sf::Time preroll;
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            preroll = stream.getPrerollDuration();
+            size_t queuedId;
+            if (stream.getQueuedTrackId(queuedId) && queuedId == command.trackId && stream.openQueued(command.crossfade)) {
+                hasTrack = true;
+                // A crossfade leaves the stream playing; play() would restart it and cut the fade
+                if (command.play && stream.getStatus() != sf::SoundSource::Playing) {
+                    stream.play();
+                }
+                return;
+            }
+        }
+
+        auto track = std::make_unique<PlaybackStream::Track>();
+        bool opened = track->open(command.path, command.trackId, preroll);
+        track->setGain(command.gain);
+        if (isSuperseded(CommandType::Open)) {
+            return; // Someone already asked for another song while this one was opening
+        }
+
+        if (!opened) {
+            std::cerr << "Error loading music file: " << command.path << std::endl;
+            hasTrack = false;
+            std::lock_guard<std::mutex> lock(streamMutex);
+            stream.stop(); // Reads as finished, so the player moves on to the next song
+            return;
+        }
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.setCurrent(std::move(track), command.crossfade);
+        hasTrack = true;
+        // As above: only a hard cut leaves the stream stopped
+        if (command.play && stream.getStatus() != sf::SoundSource::Playing) {
+            stream.play();
+        }
+        break;
+    }
+    case CommandType::Queue: {
+        // Tracks are decoded further ahead while crossfading, so a fade never waits for the disk
+        sf::Time preroll;
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            preroll = stream.getPrerollDuration();
+        }
+        auto track = std::make_unique<PlaybackStream::Track>();
+        if (!track->open(command.path, command.trackId, preroll)) {
+            std::cerr << "Error loading music file: " << command.path << std::endl;
+            return;
+        }
+        track->setGain(command.gain);
+        if (isSuperseded(CommandType::Queue)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.setQueued(std::move(track));
+        break;
+    }
+    case CommandType::ClearQueue: {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.clearNext();
+        break;
+    }
+    case CommandType::Seek: {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.setTrackOffset(command.offset);
+        break;
+    }
+    case CommandType::Play: {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.play();
+        break;
+    }
+    case CommandType::Pause: {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream.pause();
+        break;
+    }
+    }
+}
@@ -0,0 +1,142 @@
+#include "../header/TrackStore.hpp"
+#include "../header/Utilities.hpp"
+#include <algorithm>
+#include <limits>
+
+TrackStore::TrackStore(const std::vector<std::string>& paths) {
+    reserve(paths.size());
+    for (const auto& path : paths) {
+        add(path);
+    }
+}
+
+TrackStore::TrackStore(const TrackStore* base) : base(base), baseCount(base ? base->size() : 0) {}
+
+void TrackStore::reserve(size_t count) {
+    nameStarts.reserve(count + 1);
+    directoryIds.reserve(count);
+    extensionLengths.reserve(count);
+    // A guess at the typical file name; saves most of the arena's regrowth
+    names.reserve(count * 24);
+}
+
+void TrackStore::shrinkToFit() {
+    directories.shrink_to_fit();
+    directoryStarts.shrink_to_fit();
+    names.shrink_to_fit();
+    nameStarts.shrink_to_fit();
+    directoryIds.shrink_to_fit();
+    extensionLengths.shrink_to_fit();
+}
+
+void TrackStore::add(std::string_view path) {
+    size_t slash = path.find_last_of("/\\");
+    size_t nameStart = slash == std::string_view::npos ? 0 : slash + 1;
+    std::string_view name = path.substr(nameStart);
+    size_t dot = name.find_last_of('.');
+    size_t extensionLength = dot == std::string_view::npos ? 0 : name.size() - dot;
+    // File systems cap names at 255 bytes, so this only guards against nonsense input
+    if (extensionLength > std::numeric_limits<std::uint16_t>::max()) {
+        extensionLength = 0;
+    }
+
+    directoryIds.push_back(internDirectory(path.substr(0, nameStart)));
+    names.append(name);
+    nameStarts.push_back(static_cast<std::uint32_t>(names.size()));
+    extensionLengths.push_back(static_cast<std::uint16_t>(extensionLength));
+}
+
+std::uint32_t TrackStore::internDirectory(std::string_view directory) {
+    if (getDirectoryCount() > 0 && getDirectoryAt(lastDirectory) == directory) {
+        return lastDirectory;
+    }
+    // Keep the table at most half full
+    if ((getDirectoryCount() + 1) * 2 > directorySlots.size()) {
+        growSlots();
+    }
+    size_t mask = directorySlots.size() - 1;
+    size_t slot = static_cast<size_t>(hashPath(directory)) & mask;
+    while (directorySlots[slot] != 0) {
+        std::uint32_t index = directorySlots[slot] - 1;
+        if (getDirectoryAt(index) == directory) {
+            lastDirectory = index;
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    std::uint32_t index = static_cast<std::uint32_t>(getDirectoryCount());
+    directories.append(directory);
+    directoryStarts.push_back(static_cast<std::uint32_t>(directories.size()));
+    directorySlots[slot] = index + 1;
+    lastDirectory = index;
+    return index;
+}
+
+void TrackStore::growSlots() {
+    std::vector<std::uint32_t> slots(std::max<size_t>(64, directorySlots.size() * 2), 0);
+    size_t mask = slots.size() - 1;
+    for (std::uint32_t index = 0; index < getDirectoryCount(); ++index) {
+        size_t slot = static_cast<size_t>(hashPath(getDirectoryAt(index))) & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = index + 1;
+    }
+    directorySlots.swap(slots);
+}
+
+std::string_view TrackStore::getDirectoryAt(std::uint32_t index) const {
+    return std::string_view(directories.data() + directoryStarts[index], directoryStarts[index + 1] - directoryStarts[index]);
+}
+
+std::string_view TrackStore::getDirectory(size_t id) const {
+    if (id < baseCount) {
+        return base->getDirectory(id);
+    }
+    return getDirectoryAt(directoryIds[id - baseCount]);
+}
+
+std::string_view TrackStore::getFileName(size_t id) const {
+    if (id < baseCount) {
+        return base->getFileName(id);
+    }
+    id -= baseCount;
+    return std::string_view(names.data() + nameStarts[id], nameStarts[id + 1] - nameStarts[id]);
+}
+
+std::string_view TrackStore::getBaseName(size_t id) const {
+    if (id < baseCount) {
+        return base->getBaseName(id);
+    }
+    std::string_view name = getFileName(id);
+    return name.substr(0, name.size() - extensionLengths[id - baseCount]);
+}
+
+std::string_view TrackStore::getExtension(size_t id) const {
+    if (id < baseCount) {
+        return base->getExtension(id);
+    }
+    std::string_view name = getFileName(id);
+    return name.substr(name.size() - extensionLengths[id - baseCount]);
+}
+
+std::string TrackStore::getPath(size_t id) const {
+    std::string path;
+    getPath(id, path);
+    return path;
+}
+
+void TrackStore::getPath(size_t id, std::string& path) const {
+    std::string_view directory = getDirectory(id);
+    std::string_view name = getFileName(id);
+    path.reserve(directory.size() + name.size());
+    path.assign(directory);
+    path.append(name);
+}
+
+size_t TrackStore::getMemoryUsage() const {
+    return directories.capacity() + names.capacity()
+        + (directoryStarts.capacity() + directorySlots.capacity() + nameStarts.capacity() + directoryIds.capacity()) * sizeof(std::uint32_t)
+        + extensionLengths.capacity() * sizeof(std::uint16_t);
+}
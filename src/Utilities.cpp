@@ -1,7 +1,13 @@
 #include "../header/Utilities.hpp"
+#include "../header/Profiler.hpp"
 #include <algorithm>
 #include <sstream>
 #include <cctype>
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 std::string getBaseName(const std::string& path) {
     std::string filename = path.substr(path.find_last_of("/\\") + 1);
@@ -30,6 +36,7 @@ std::string wrapText(const std::string& text, unsigned int lineLength) {
 }
 
 void filterMusicFiles(const std::vector<std::string>& musicFiles, const std::string& query, std::vector<std::string>& filtered) {
+    PROFILE_SCOPE("filterMusicFiles");
     filtered.clear();
     std::string lowercaseQuery = query;
 
@@ -51,4 +58,26 @@ void filterMusicFiles(const std::vector<std::string>& musicFiles, const std::str
             filtered.push_back(file);
         }
     }
-}
\ No newline at end of file
+}
+
+// 64-bit FNV-1a, used as a stable on-disk key for per-file caches
+std::uint64_t hashPath(std::string_view path) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t getResidentMemory() {
+#ifdef __linux__
+    // Total and resident size, in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if (statm >> totalPages >> residentPages) {
+        return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
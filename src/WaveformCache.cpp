@@ -0,0 +1,264 @@
+#include "../header/WaveformCache.hpp"
+#include "../header/LoudnessMeter.hpp"
+#include "../header/Profiler.hpp"
+#include "../header/Utilities.hpp"
+#include <SFML/Audio.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char cacheMagic[8] = { 'M', 'P', 'P', 'E', 'A', 'K', '1', '\0' };
+const size_t maxLoaded = 8;             // Thumbnails kept in memory; the current track and a few recent ones
+const size_t decodeBlockSamples = 1 << 16;
+
+struct CacheHeader {
+    char magic[8];
+    std::uint64_t size;         // Of the audio file it was built from
+    std::int64_t mtime;
+    std::uint64_t frameCount;
+    std::uint32_t framesPerPeak;
+    std::uint32_t peakCount;
+};
+static_assert(sizeof(CacheHeader) == 40, "CacheHeader is part of the cache file format");
+static_assert(sizeof(Peak) == 2 && std::is_trivially_copyable<Peak>::value, "Peak is part of the cache file format");
+
+// True if the file starts with a header for this version of the audio file
+bool readHeader(std::ifstream& in, std::uint64_t size, std::int64_t mtime, CacheHeader& header) {
+    return in.read(reinterpret_cast<char*>(&header), sizeof(header)) && std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+        header.size == size && header.mtime == mtime && header.framesPerPeak == PeakPyramid::baseFramesPerPeak;
+}
+
+} // namespace
+
+WaveformCache::WaveformCache(const std::string& directory, const TrackStore& tracks, const FileStamps& stamps, LoudnessCache* loudness,
+    unsigned int threadCount)
+    : directory(directory), tracks(tracks), stamps(stamps), loudness(loudness), states(tracks.size(), TrackState::Unknown),
+      wanted(tracks.size(), false) {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    // Decoding is CPU bound; leave room for the audio and GUI threads. The loudness
+    // analysis rides along on these decodes rather than adding threads of its own.
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&WaveformCache::work, this);
+    }
+}
+
+WaveformCache::~WaveformCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+void WaveformCache::prefetchAll() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        prefetchEnd = tracks.size();
+    }
+    wake.notify_all();
+}
+
+std::shared_ptr<const PeakPyramid> WaveformCache::get(size_t track) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (track >= tracks.size()) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (loaded[i].first == track) {
+            std::rotate(loaded.begin() + i, loaded.begin() + i + 1, loaded.end());
+            return loaded.back().second;
+        }
+    }
+    if (states[track] != TrackState::Failed && !wanted[track]) {
+        wanted[track] = true;
+        // A worker already on the track publishes it when done
+        if (states[track] != TrackState::Working) {
+            requests.push_front(track);
+            wake.notify_one();
+        }
+    }
+    return nullptr;
+}
+
+void WaveformCache::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !requests.empty() || nextPrefetch < prefetchEnd; });
+        if (stopping) {
+            return;
+        }
+        size_t track;
+        if (!requests.empty()) {
+            track = requests.front();
+            requests.pop_front();
+        }
+        else {
+            track = nextPrefetch++;
+        }
+
+        TrackState state = states[track];
+        bool publish = wanted[track];
+        bool measure = loudness && loudness->needsMeasuring(track);
+        if (state == TrackState::Working || (state == TrackState::OnDisk && !publish && !measure)) {
+            continue;
+        }
+        if (state == TrackState::Failed) {
+            wanted[track] = false;
+            continue;
+        }
+        states[track] = TrackState::Working;
+        lock.unlock();
+
+        // Requested thumbnails are needed in memory; prefetched ones only on disk
+        PeakPyramid pyramid;
+        bool inMemory = publish && load(track, pyramid);
+        bool ok = inMemory || (!publish && isOnDisk(track));
+        // A requested thumbnail that is on disk is handed over without waiting for a decode
+        bool measureLater = ok && publish && measure;
+        if ((!ok || (measure && !measureLater)) && !stopping) {
+            bool decoded = decode(track, ok ? nullptr : &pyramid, measure);
+            if (!ok) {
+                inMemory = ok = decoded;
+                if (ok) {
+                    save(track, pyramid);
+                }
+            }
+        }
+
+        lock.lock();
+        if (stopping) {
+            return;
+        }
+        states[track] = ok ? TrackState::OnDisk : TrackState::Failed;
+        if (!ok) {
+            wanted[track] = false;
+        }
+        else if (wanted[track] && inMemory) {
+            wanted[track] = false;
+            loaded.emplace_back(track, std::make_shared<const PeakPyramid>(std::move(pyramid)));
+            if (loaded.size() > maxLoaded) {
+                loaded.erase(loaded.begin());
+            }
+        }
+        else if (wanted[track]) {
+            // Asked for while this worker only checked the disk; load it on the next pass
+            requests.push_front(track);
+            wake.notify_one();
+        }
+        if (measureLater) {
+            // Behind every request, but before the prefetch pass carries on
+            requests.push_back(track);
+            wake.notify_one();
+        }
+    }
+}
+
+std::string WaveformCache::getCachePath(size_t track) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.peaks", static_cast<unsigned long long>(hashPath(tracks.getPath(track))));
+    return (fs::path(directory) / name).string();
+}
+
+bool WaveformCache::isOnDisk(size_t track) const {
+    std::ifstream in(getCachePath(track), std::ios::binary);
+    CacheHeader header;
+    return in && readHeader(in, stamps.sizes[track], stamps.mtimes[track], header);
+}
+
+bool WaveformCache::load(size_t track, PeakPyramid& pyramid) const {
+    std::ifstream in(getCachePath(track), std::ios::binary);
+    CacheHeader header;
+    if (!in || !readHeader(in, stamps.sizes[track], stamps.mtimes[track], header)) {
+        return false;
+    }
+    std::vector<Peak> peaks(header.peakCount);
+    if (!in.read(reinterpret_cast<char*>(peaks.data()), peaks.size() * sizeof(Peak))) {
+        return false;
+    }
+    return pyramid.assign(header.frameCount, std::move(peaks));
+}
+
+bool WaveformCache::decode(size_t track, PeakPyramid* pyramid, bool measure) const {
+    PROFILE_SCOPE("WaveformCache::decode");
+    sf::InputSoundFile file;
+    std::string path = tracks.getPath(track);
+    if (!file.openFromFile(path)) {
+        std::cerr << "Error decoding waveform: " << path << std::endl;
+        return false;
+    }
+    unsigned int channelCount = file.getChannelCount();
+    if (channelCount == 0) {
+        return false;
+    }
+    std::optional<LoudnessMeter> meter;
+    if (measure) {
+        meter.emplace(file.getSampleRate(), channelCount);
+    }
+    // Whole frames per read, so a block never splits one between channels
+    std::vector<sf::Int16> samples(decodeBlockSamples / channelCount * channelCount);
+    sf::Uint64 count;
+    while ((count = file.read(samples.data(), samples.size())) > 0) {
+        if (stopping) {
+            return false;
+        }
+        size_t frameCount = static_cast<size_t>(count) / channelCount;
+        if (pyramid) {
+            pyramid->append(samples.data(), frameCount, channelCount);
+        }
+        if (meter) {
+            meter->addFrames(samples.data(), frameCount);
+        }
+    }
+    if (pyramid) {
+        pyramid->finish();
+    }
+    if (meter) {
+        loudness->store(track, static_cast<float>(meter->getIntegratedLoudness()), static_cast<float>(meter->getTruePeak()));
+    }
+    return true;
+}
+
+bool WaveformCache::save(size_t track, const PeakPyramid& pyramid) const {
+    std::string cachePath = getCachePath(track);
+    std::string temporaryPath = cachePath + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header;
+        std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.size = stamps.sizes[track];
+        header.mtime = stamps.mtimes[track];
+        header.frameCount = pyramid.getFrameCount();
+        header.framesPerPeak = PeakPyramid::baseFramesPerPeak;
+        header.peakCount = static_cast<std::uint32_t>(pyramid.getPeaks().size());
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(pyramid.getPeaks().data()), pyramid.getPeaks().size() * sizeof(Peak));
+        if (!out) {
+            std::cerr << "Error writing waveform cache: " << cachePath << std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temporaryPath, cachePath, ec);
+    if (ec) {
+        std::cerr << "Error writing waveform cache: " << cachePath << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
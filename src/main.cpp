@@ -7,50 +7,266 @@
 #include "../header/MusicPlayer.hpp"
 #include "../header/GUI.hpp"
 #include "../header/Utilities.hpp"
+#include "../header/LibraryScanner.hpp"
+#include "../header/Playlist.hpp"
+#include "../header/LibraryWatcher.hpp"
+#include "../header/TrackStore.hpp"
+#include "../header/MetadataCache.hpp"
+#include "../header/WaveformCache.hpp"
+#include "../header/LoudnessCache.hpp"
+#include "../header/FrameScheduler.hpp"
+#include "../header/Profiler.hpp"
+#include "../header/ControlServer.hpp"
 #include <algorithm>
+#include <csignal>
+#include <cstdlib>
 
 namespace fs = std::filesystem;
 
-std::vector<std::string> getSongsFromDirectory(const std::string& directoryPath) {
-    std::vector<std::string> musicFiles;
-    
-    for (const auto & entry : fs::directory_iterator(directoryPath)) {
-        if (entry.is_regular_file()) {
-            std::string extension = entry.path().extension().string();
-            if (extension == ".mp3" || extension == ".wav" || extension == ".ogg") {
-                musicFiles.push_back(entry.path().string());
-            }
+std::vector<LibraryEntry> getSongsFromDirectory(const std::string& directoryPath) {
+    // The index lives outside the Songs directory so saving it never bumps the library's mtime
+    LibraryScanner scanner(directoryPath, "../Cache/library.idx");
+    return scanner.scan();
+}
+
+std::vector<LibraryEntry> getSongsFromPlaylist(const std::string& playlistPath) {
+    std::vector<std::string> paths;
+    if (!Playlist::load(playlistPath, paths)) {
+        return {};
+    }
+    // Entries whose files are gone are left out, as a scan would never have found them
+    std::vector<LibraryEntry> entries = LibraryScanner::statExistingFiles(paths);
+    if (entries.size() < paths.size()) {
+        std::cerr << "Skipped " << paths.size() - entries.size() << " playlist entries whose files cannot be read: " << playlistPath << std::endl;
+    }
+    return entries;
+}
+
+namespace {
+
+ControlServer* activeServer = nullptr;
+
+void stopServer(int) {
+    if (activeServer) {
+        activeServer->stop();
+    }
+}
+
+// Band gains in dB, comma separated, lowest band first; missing bands stay flat
+void applyEqualizer(ParametricEq& equalizer, const std::string& gains) {
+    size_t band = 0;
+    size_t start = 0;
+    while (start <= gains.size() && band < equalizer.getBandCount()) {
+        size_t end = gains.find(',', start);
+        if (end == std::string::npos) {
+            end = gains.size();
         }
+        ParametricEq::Band settings = equalizer.getBand(band);
+        settings.gain = static_cast<float>(std::atof(gains.substr(start, end - start).c_str()));
+        equalizer.setBand(band++, settings);
+        start = end + 1;
     }
-    
-    return musicFiles;
 }
 
-int main() {
-    // Get desktop mode and reduce height by a bit to avoid overlapping the taskbar
-    sf::VideoMode desktopMode = sf::VideoMode::getDesktopMode();
-    sf::RenderWindow window(sf::VideoMode(desktopMode.width - 3, desktopMode.height - 90), "SFML Music Player", sf::Style::Default);
+bool parseFadeCurve(const std::string& name, PlaybackStream::FadeCurve& curve) {
+    if (name == "linear") {
+        curve = PlaybackStream::FadeCurve::Linear;
+    }
+    else if (name == "equal-power") {
+        curve = PlaybackStream::FadeCurve::EqualPower;
+    }
+    else if (name == "s-curve") {
+        curve = PlaybackStream::FadeCurve::SCurve;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
 
-    // Get the songs from the Songs directory
+// With --profile, how much the whole process holds once everything per track is built
+void reportMemory(size_t trackCount) {
+    size_t resident = getResidentMemory();
+    if (!Profiler::isEnabled() || resident == 0) {
+        return;
+    }
+    std::cout << "Resident memory after startup: " << resident / (1024 * 1024) << " MB, "
+        << resident / trackCount << " bytes per track" << std::endl;
+}
+
+void configureDsp(MusicPlayer& player, float preampDecibels, const std::string& equalizerGains) {
+    player.getPreamp().setGain(preampDecibels);
+    if (!equalizerGains.empty()) {
+        applyEqualizer(player.getEqualizer(), equalizerGains);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Animated pages are drawn at most this often; --fps=N changes it
+    unsigned int maxFramesPerSecond = 60;
+    // --headless plays without a window, controlled through a local socket
+    bool headless = false;
+    std::string socketPath = "../Cache/player.sock";
+    // Loudness normalization is on unless --no-normalize is given
+    bool normalize = true;
+    // --preamp=DB and --eq=G1,G2,... set up the DSP chain (10 bands, 31 Hz to 16 kHz)
+    float preampDecibels = 0.0f;
+    std::string equalizerGains;
+    // --crossfade=SECONDS fades songs into each other; --fade-curve=linear|equal-power|s-curve shapes it
+    float crossfadeSeconds = 0.f;
+    PlaybackStream::FadeCurve fadeCurve = PlaybackStream::FadeCurve::EqualPower;
+    // --playlist=PATH plays an M3U/PLS playlist instead of the Songs directory;
+    // --export-playlist=PATH writes the songs found to a playlist and exits
+    std::string playlistPath;
+    std::string exportPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument.rfind("--fps=", 0) == 0) {
+            int fps = std::atoi(argument.c_str() + 6);
+            if (fps > 0) {
+                maxFramesPerSecond = static_cast<unsigned int>(fps);
+            }
+            else {
+                std::cerr << "Ignoring invalid frame rate: " << argument << std::endl;
+            }
+        }
+        else if (argument == "--headless") {
+            headless = true;
+        }
+        else if (argument.rfind("--socket=", 0) == 0) {
+            socketPath = argument.substr(9);
+        }
+        else if (argument == "--no-normalize") {
+            normalize = false;
+        }
+        else if (argument.rfind("--preamp=", 0) == 0) {
+            preampDecibels = static_cast<float>(std::atof(argument.c_str() + 9));
+        }
+        else if (argument.rfind("--eq=", 0) == 0) {
+            equalizerGains = argument.substr(5);
+        }
+        else if (argument.rfind("--crossfade=", 0) == 0) {
+            crossfadeSeconds = std::max(0.f, static_cast<float>(std::atof(argument.c_str() + 12)));
+        }
+        else if (argument.rfind("--fade-curve=", 0) == 0) {
+            if (!parseFadeCurve(argument.substr(13), fadeCurve)) {
+                std::cerr << "Ignoring unknown fade curve: " << argument << std::endl;
+            }
+        }
+        else if (argument.rfind("--playlist=", 0) == 0) {
+            playlistPath = argument.substr(11);
+        }
+        else if (argument.rfind("--export-playlist=", 0) == 0) {
+            exportPath = argument.substr(18);
+        }
+        else if (argument == "--profile") {
+            Profiler::setEnabled(true); // From the first frame, so an exported trace covers startup
+        }
+        else {
+            std::cerr << "Unknown argument: " << argument << std::endl;
+        }
+    }
+
+    // Get the songs from the playlist, or else the Songs directory
     std::string songsDirectory = "../Songs";
-    std::vector<std::string> musicFiles = getSongsFromDirectory(songsDirectory);
+    std::vector<LibraryEntry> libraryEntries = playlistPath.empty() ? getSongsFromDirectory(songsDirectory) : getSongsFromPlaylist(playlistPath);
+
+    // Everything else shares one compact copy of the paths and of the sizes and mtimes,
+    // so the entries go before anything per track is built, whatever the mode
+    TrackStore library;
+    FileStamps stamps;
+    library.reserve(libraryEntries.size());
+    stamps.sizes.reserve(libraryEntries.size());
+    stamps.mtimes.reserve(libraryEntries.size());
+    for (const auto& entry : libraryEntries) {
+        library.add(entry.path);
+        stamps.sizes.push_back(entry.size);
+        stamps.mtimes.push_back(entry.mtime);
+    }
+    library.shrinkToFit();
+    std::vector<LibraryEntry>().swap(libraryEntries);
 
-    if (musicFiles.empty()) {
-        std::cerr << "No music files found in the Songs directory." << std::endl;
+    if (library.empty()) {
+        std::cerr << "No music files found in " << (playlistPath.empty() ? "the Songs directory." : "the playlist.") << std::endl;
         return 1;
     }
 
-    // Create the music player
-    MusicPlayer player(musicFiles);
+    if (!exportPath.empty()) {
+        std::vector<std::string> paths;
+        paths.reserve(library.size());
+        for (size_t track = 0; track < library.size(); ++track) {
+            paths.push_back(library.getPath(track));
+        }
+        return Playlist::save(exportPath, paths) ? 0 : 1;
+    }
 
-    GUI gui(window, player);
+    // Tracks are measured in the background; each plays normalized once its loudness is known
+    LoudnessCache loudness("../Cache/loudness.bin", library, stamps);
+
+    // Songs copied into or deleted from the Songs directory show up without a restart.
+    // A playlist stays as it was loaded.
+    LibraryWatcher watcher(songsDirectory, library);
+    if (playlistPath.empty()) {
+        watcher.start();
+    }
 
-    // Start the game loop
-    while (window.isOpen()) {
-        gui.handleEvents();
-        gui.update();
-        gui.draw();
+    if (headless) {
+        // No window, fonts or metadata: just the player and its control socket.
+        // Tracks the watcher finds are appended on top of the library, which the
+        // caches and the watcher keep reading from their own threads.
+        MusicPlayer player(TrackStore{ &library });
+        if (normalize) {
+            // Nothing else decodes the library here, so the cache measures it with threads of its own
+            loudness.start();
+            player.setLoudness(&loudness);
+        }
+        configureDsp(player, preampDecibels, equalizerGains);
+        player.setCrossfade(crossfadeSeconds, fadeCurve);
+        ControlServer server(player, socketPath);
+        server.watchLibrary(&watcher);
+        activeServer = &server;
+        reportMemory(library.size());
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        bool served = server.run();
+        activeServer = nullptr;
+        return served ? 0 : 1;
     }
 
+    // Get desktop mode and reduce height by a bit to avoid overlapping the taskbar
+    sf::VideoMode desktopMode = sf::VideoMode::getDesktopMode();
+    sf::RenderWindow window(sf::VideoMode(desktopMode.width - 3, desktopMode.height - 90), "SFML Music Player", sf::Style::Default);
+
+    // Durations and tags are read once per file and then served from the mapped cache.
+    // Files it does not have yet are read in the background; their rows show up
+    // without details until the GUI takes the rewritten cache.
+    MetadataCache metadata("../Cache/metadata.bin");
+    metadata.load();
+    metadata.startUpdate(library, stamps);
+
+    // Create the music player; it appends new tracks on top of the library, as above
+    MusicPlayer player(TrackStore{ &library });
+    if (normalize) {
+        loudness.open();
+        player.setLoudness(&loudness);
+    }
+    configureDsp(player, preampDecibels, equalizerGains);
+    player.setCrossfade(crossfadeSeconds, fadeCurve);
+
+    // Waveform thumbnails are decoded in the background, the playing track first, and
+    // the same decode measures the loudness of tracks that have not been measured yet
+    WaveformCache waveforms("../Cache/waveforms", library, stamps, normalize ? &loudness : nullptr);
+    waveforms.prefetchAll();
+
+    GUI gui(window, player, metadata, waveforms);
+    gui.watchLibrary(&watcher);
+    reportMemory(library.size());
+
+    // Start the main loop; it sleeps whenever nothing on screen changes
+    FrameScheduler scheduler(window, gui, maxFramesPerSecond);
+    scheduler.run();
+
     return 0;
 }
\ No newline at end of file